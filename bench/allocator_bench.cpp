@@ -0,0 +1,36 @@
+#include "bench.h"
+#include "poolallocator.h"
+
+#include <vector>
+
+namespace
+{
+    using namespace coda;
+
+    // allocates a batch of small blocks of mixed sizes and releases it in reverse
+    template <typename AllocatorType>
+    void allocateRelease(bench::state& state)
+    {
+        const size_t batchSize = 256;
+        const size_t maxSize = static_cast<size_t>(state.getArg());
+        std::vector<void*> blocks(batchSize);
+        uint64 iterations = state.getIterations();
+        uint64 done = 0;
+        while (done < iterations)
+        {
+            for (size_t i = 0; i < batchSize; ++i)
+                blocks[i] = AllocatorType::allocate(8 + (i * 40503u) % maxSize);
+            bench::doNotOptimize(blocks.data());
+            for (size_t i = batchSize; i > 0; --i)
+                AllocatorType::release(blocks[i - 1]);
+            done += batchSize;
+        }
+        state.setItemsProcessed(done);
+    }
+
+    void baseallocator_allocateRelease(bench::state& state) { allocateRelease<baseallocator>(state); }
+    CODA_BENCHMARK(baseallocator_allocateRelease, 32, 128, 512);
+
+    void poolallocator_allocateRelease(bench::state& state) { allocateRelease<poolallocator>(state); }
+    CODA_BENCHMARK(poolallocator_allocateRelease, 32, 128, 512);
+}
@@ -0,0 +1,160 @@
+#include "bench.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+namespace coda
+{
+    namespace bench
+    {
+        struct benchmarkinfo
+        {
+            const char* name;
+            benchmarkfunction function;
+            std::vector<int64> args;
+        };
+
+        struct benchmarkresult
+        {
+            char name[128];
+            uint64 iterations;
+            double nsPerIteration;
+            double itemsPerSecond;
+        };
+
+        static std::vector<benchmarkinfo>& getBenchmarks()
+        {
+            static std::vector<benchmarkinfo> benchmarks;
+            return benchmarks;
+        }
+
+        void state::pauseTiming()
+        {
+            coda_assert(!paused);
+            elapsed += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            paused = true;
+        }
+
+        void state::resumeTiming()
+        {
+            coda_assert(paused);
+            paused = false;
+            start = std::chrono::steady_clock::now();
+        }
+
+        registrar::registrar(const char* name, benchmarkfunction function, std::initializer_list<int64> args)
+        {
+            getBenchmarks().push_back({ name, function, args });
+        }
+
+        static state runOnce(benchmarkfunction function, uint64 iterations, int64 arg)
+        {
+            state s(iterations, arg);
+            s.resumeTiming();
+            function(s);
+            s.pauseTiming();
+            return s;
+        }
+
+        // Grows the iteration count until a run lasts at least minTime
+        static state measure(benchmarkfunction function, int64 arg, double minTime)
+        {
+            uint64 iterations = 1;
+            for (;;)
+            {
+                state s = runOnce(function, iterations, arg);
+                double elapsed = s.getElapsedSeconds();
+                if (elapsed >= minTime || iterations >= (1ull << 40))
+                    return s;
+                double scale = elapsed > 0.0 ? minTime * 1.4 / elapsed : 100.0;
+                scale = scale < 2.0 ? 2.0 : (scale > 100.0 ? 100.0 : scale);
+                iterations = static_cast<uint64>(static_cast<double>(iterations) * scale);
+            }
+        }
+
+        static bool writeJson(const char* path, const std::vector<benchmarkresult>& results)
+        {
+            FILE* file = fopen(path, "w");
+            if (!file)
+                return false;
+            // names are identifiers, template arguments and numbers, nothing to escape
+            fprintf(file, "{\n  \"benchmarks\": [\n");
+            for (size_t i = 0; i < results.size(); ++i)
+            {
+                const benchmarkresult& r = results[i];
+                fprintf(file, "    {\"name\": \"%s\", \"iterations\": %llu, \"ns_per_iteration\": %.4f, \"items_per_second\": %.6g}%s\n",
+                    r.name, r.iterations, r.nsPerIteration, r.itemsPerSecond, i + 1 < results.size() ? "," : "");
+            }
+            fprintf(file, "  ]\n}\n");
+            fclose(file);
+            return true;
+        }
+
+        int runBenchmarks(int argc, char** argv)
+        {
+            const char* filter = nullptr;
+            const char* jsonPath = nullptr;
+            double minTime = 0.2;
+            for (int i = 1; i < argc; ++i)
+            {
+                if (!strncmp(argv[i], "--filter=", 9))
+                    filter = argv[i] + 9;
+                else if (!strncmp(argv[i], "--min_time=", 11))
+                    minTime = atof(argv[i] + 11);
+                else if (!strncmp(argv[i], "--json=", 7))
+                    jsonPath = argv[i] + 7;
+                else
+                {
+                    printf("Usage: %s [--filter=substring] [--min_time=seconds] [--json=path]\n", argv[0]);
+                    return 1;
+                }
+            }
+
+            std::vector<benchmarkresult> results;
+
+            printf("%-48s %14s %14s %16s\n", "Benchmark", "Iterations", "ns/iter", "items/s");
+            for (const benchmarkinfo& info : getBenchmarks())
+            {
+                if (filter && !strstr(info.name, filter))
+                    continue;
+                std::vector<int64> args = info.args;
+                if (args.empty())
+                    args.push_back(0);
+                for (int64 arg : args)
+                {
+                    benchmarkresult result;
+                    if (info.args.empty())
+                        snprintf(result.name, sizeof(result.name), "%s", info.name);
+                    else
+                        snprintf(result.name, sizeof(result.name), "%s/%lld", info.name, static_cast<long long>(arg));
+
+                    state s = measure(info.function, arg, minTime);
+                    double elapsed = s.getElapsedSeconds();
+                    result.iterations = s.getIterations();
+                    result.nsPerIteration = elapsed * 1e9 / static_cast<double>(s.getIterations());
+                    result.itemsPerSecond = s.getItemsProcessed() ? static_cast<double>(s.getItemsProcessed()) / elapsed : 0.0;
+                    if (s.getItemsProcessed())
+                        printf("%-48s %14llu %14.2f %16.4g\n", result.name, result.iterations, result.nsPerIteration, result.itemsPerSecond);
+                    else
+                        printf("%-48s %14llu %14.2f %16s\n", result.name, result.iterations, result.nsPerIteration, "-");
+                    fflush(stdout);
+                    results.push_back(result);
+                }
+            }
+
+            if (jsonPath && !writeJson(jsonPath, results))
+            {
+                printf("Can't write %s\n", jsonPath);
+                return 1;
+            }
+            return 0;
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    return coda::bench::runBenchmarks(argc, argv);
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "common.h"
+#include <chrono>
+#include <initializer_list>
+
+namespace coda
+{
+    namespace bench
+    {
+        // Timing state of a single benchmark run
+        class state
+        {
+        public:
+            state(uint64 _iterations, int64 _arg) : iterations(_iterations), arg(_arg), items(0), elapsed(0), paused(true) {}
+
+            // Number of times the benchmark must repeat the measured operation
+            uint64 getIterations() const { return iterations; }
+            // Argument the benchmark was registered with, 0 if none
+            int64 getArg() const { return arg; }
+
+            // Operations processed in total, used to report throughput
+            void setItemsProcessed(uint64 _items) { items = _items; }
+            uint64 getItemsProcessed() const { return items; }
+
+            // Excludes setup work from the measurement
+            void pauseTiming();
+            void resumeTiming();
+
+            double getElapsedSeconds() const { return elapsed; }
+
+        private:
+            uint64 iterations;
+            int64 arg;
+            uint64 items;
+            double elapsed;
+            bool paused;
+            std::chrono::steady_clock::time_point start;
+        };
+
+        typedef void (*benchmarkfunction)(state&);
+
+        // Static registration, see CODA_BENCHMARK
+        struct registrar
+        {
+            registrar(const char* name, benchmarkfunction function, std::initializer_list<int64> args = {});
+        };
+
+        int runBenchmarks(int argc, char** argv);
+
+        // Keeps the optimizer from dropping a value the benchmark computes
+        template <typename T>
+        inline void doNotOptimize(const T& value)
+        {
+#if defined(_MSC_VER)
+            const volatile char* sink = reinterpret_cast<const volatile char*>(&value);
+            (void)*sink;
+#else
+            asm volatile("" : : "r,m"(value) : "memory");
+#endif
+        }
+    }
+}
+
+// Registers a benchmark, optionally once per argument: CODA_BENCHMARK(function, 1, 2, 4)
+#define CODA_BENCHMARK(function, ...) static coda::bench::registrar function##_registrar(#function, function, {__VA_ARGS__})
+
+#define CODA_BENCHMARK_CONCAT_(a, b) a##b
+#define CODA_BENCHMARK_CONCAT(a, b) CODA_BENCHMARK_CONCAT_(a, b)
+// Same with an explicit name, for template instances: CODA_BENCHMARK_NAMED("push<int>", push<int>, 16)
+#define CODA_BENCHMARK_NAMED(name, function, ...) static coda::bench::registrar CODA_BENCHMARK_CONCAT(benchmark_registrar_, __COUNTER__)(name, function, {__VA_ARGS__})
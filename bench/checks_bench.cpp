@@ -0,0 +1,96 @@
+#include "bench.h"
+#include "dynarray.h"
+#include "starray.h"
+
+#include <vector>
+
+namespace
+{
+    using namespace coda;
+
+    enum class access { checked, unchecked, spanned };
+
+    // Sums the first count elements of an array through operator[] (bounds checked), at_unchecked or a
+    // span. count comes from outside so the compiler can't prove the bounds checks away.
+    template <access Access, typename ArrayType>
+    uint32 sumElements(const ArrayType& arr, uint32 count)
+    {
+        uint32 sum = 0;
+        if constexpr (Access == access::checked)
+        {
+            for (uint32 i = 0; i < count; ++i)
+                sum += arr[i];
+        }
+        else if constexpr (Access == access::unchecked)
+        {
+            for (uint32 i = 0; i < count; ++i)
+                sum += arr.at_unchecked(i);
+        }
+        else
+        {
+            for (uint32 value : arr.getSpan().getSubspan(0, count))
+                sum += value;
+        }
+        return sum;
+    }
+
+    template <access Access>
+    void dynarraySum(bench::state& state)
+    {
+        const uint32 count = static_cast<uint32>(state.getArg());
+        dynarray<uint32> arr(count);
+        for (uint32 i = 0; i < count; ++i)
+            arr.pushBack(i);
+
+        uint64 iterations = state.getIterations();
+        for (uint64 i = 0; i < iterations; ++i)
+        {
+            bench::doNotOptimize(arr.getData());
+            bench::doNotOptimize(sumElements<Access>(arr, count));
+        }
+        state.setItemsProcessed(iterations * count);
+    }
+
+    template <access Access>
+    void starraySum(bench::state& state)
+    {
+        static starray<uint32, 4096> arr;
+        arr.resize(4096);
+        for (uint32 i = 0; i < arr.getSize(); ++i)
+            arr[i] = i;
+
+        uint64 iterations = state.getIterations();
+        for (uint64 i = 0; i < iterations; ++i)
+        {
+            bench::doNotOptimize(arr.getData());
+            bench::doNotOptimize(sumElements<Access>(arr, arr.getSize()));
+        }
+        state.setItemsProcessed(iterations * arr.getSize());
+    }
+
+    void vectorSum(bench::state& state)
+    {
+        std::vector<uint32> vec(static_cast<size_t>(state.getArg()));
+        for (size_t i = 0; i < vec.size(); ++i)
+            vec[i] = static_cast<uint32>(i);
+
+        uint64 iterations = state.getIterations();
+        for (uint64 i = 0; i < iterations; ++i)
+        {
+            bench::doNotOptimize(vec.data());
+            uint32 sum = 0;
+            for (size_t j = 0; j < vec.size(); ++j)
+                sum += vec[j];
+            bench::doNotOptimize(sum);
+        }
+        state.setItemsProcessed(iterations * vec.size());
+    }
+
+    CODA_BENCHMARK_NAMED("dynarray_sum_checked", dynarraySum<access::checked>, 1024, 65536);
+    CODA_BENCHMARK_NAMED("dynarray_sum_unchecked", dynarraySum<access::unchecked>, 1024, 65536);
+    CODA_BENCHMARK_NAMED("dynarray_sum_span", dynarraySum<access::spanned>, 1024, 65536);
+    CODA_BENCHMARK_NAMED("vector_sum", vectorSum, 1024, 65536);
+    CODA_BENCHMARK_NAMED("starray_sum_checked", starraySum<access::checked>);
+    CODA_BENCHMARK_NAMED("starray_sum_unchecked", starraySum<access::unchecked>);
+    CODA_BENCHMARK_NAMED("starray_sum_span", starraySum<access::spanned>);
+}
@@ -0,0 +1,134 @@
+#include "bench.h"
+#include "concurrenthashtable.h"
+
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    using namespace coda;
+
+    static constexpr uint32 KeyCount = 1 << 20;
+
+    // lookups spread over the whole key range without a divide per iteration
+    inline uint32 nextKey(uint32 key) { return (key + 0x9e3779b1u) & (KeyCount - 1); }
+
+    concurrenthashtable<uint32, uint32>& getConcurrentTable()
+    {
+        static concurrenthashtable<uint32, uint32>* table = []()
+            {
+                auto* t = new concurrenthashtable<uint32, uint32>(KeyCount);
+                for (uint32 i = 0; i < KeyCount; ++i)
+                    t->createItem(i, i);
+                return t;
+            }();
+        return *table;
+    }
+
+    // baseline: the plain table behind one mutex
+    struct lockedtable
+    {
+        lockedtable() : table(KeyCount) {}
+        std::mutex lock;
+        hashtable<uint32, uint32> table;
+    };
+
+    lockedtable& getLockedTable()
+    {
+        static lockedtable* table = []()
+            {
+                auto* t = new lockedtable();
+                for (uint32 i = 0; i < KeyCount; ++i)
+                    t->table.createItem(i, i);
+                return t;
+            }();
+        return *table;
+    }
+
+    template <typename Function>
+    void runThreads(bench::state& state, Function function)
+    {
+        const uint32 threadCount = static_cast<uint32>(state.getArg());
+        const uint64 iterations = state.getIterations();
+        std::vector<std::thread> threads;
+        threads.reserve(threadCount);
+        for (uint32 t = 0; t < threadCount; ++t)
+            threads.emplace_back([&function, t, iterations]() { function(t, iterations); });
+        for (std::thread& thread : threads)
+            thread.join();
+        state.setItemsProcessed(iterations * threadCount);
+    }
+
+    void concurrenthashtable_read(bench::state& state)
+    {
+        state.pauseTiming();
+        concurrenthashtable<uint32, uint32>& table = getConcurrentTable();
+        state.resumeTiming();
+        runThreads(state, [&table](uint32 thread, uint64 iterations)
+            {
+                uint32 key = thread * 7919;
+                uint32 sum = 0;
+                for (uint64 i = 0; i < iterations; ++i)
+                {
+                    uint32 value;
+                    if (table.findItem(key, value))
+                        sum += value;
+                    key = nextKey(key);
+                }
+                bench::doNotOptimize(sum);
+            });
+    }
+    CODA_BENCHMARK(concurrenthashtable_read, 1, 2, 4, 8, 16, 32, 64);
+
+    void concurrenthashtable_readMostly(bench::state& state)
+    {
+        state.pauseTiming();
+        concurrenthashtable<uint32, uint32>& table = getConcurrentTable();
+        state.resumeTiming();
+        // 1 in 16 operations replaces a key, keys stay in range so the table size is stable
+        runThreads(state, [&table](uint32 thread, uint64 iterations)
+            {
+                uint32 key = thread * 7919;
+                uint32 sum = 0;
+                for (uint64 i = 0; i < iterations; ++i)
+                {
+                    if ((i & 15) == 15)
+                    {
+                        table.destroyItem(key);
+                        table.createItem(key, key);
+                    }
+                    else
+                    {
+                        uint32 value;
+                        if (table.findItem(key, value))
+                            sum += value;
+                    }
+                    key = nextKey(key);
+                }
+                bench::doNotOptimize(sum);
+            });
+    }
+    CODA_BENCHMARK(concurrenthashtable_readMostly, 1, 2, 4, 8, 16, 32, 64);
+
+    void mutexhashtable_read(bench::state& state)
+    {
+        state.pauseTiming();
+        lockedtable& table = getLockedTable();
+        state.resumeTiming();
+        runThreads(state, [&table](uint32 thread, uint64 iterations)
+            {
+                uint32 key = thread * 7919;
+                uint32 sum = 0;
+                for (uint64 i = 0; i < iterations; ++i)
+                {
+                    std::lock_guard<std::mutex> lock(table.lock);
+                    if (uint32* value = table.table.findItem(key))
+                        sum += *value;
+                    key = nextKey(key);
+                }
+                bench::doNotOptimize(sum);
+            });
+    }
+    CODA_BENCHMARK(mutexhashtable_read, 1, 2, 4, 8, 16, 32, 64);
+}
@@ -0,0 +1,141 @@
+#include "bench.h"
+#include "dynarray.h"
+#include "starray.h"
+#include "smallarray.h"
+#include "codastring.h"
+
+#include <string>
+#include <vector>
+
+namespace
+{
+    using namespace coda;
+
+    template <typename T>
+    inline T makeValue(uint32 i) { return static_cast<T>(i); }
+
+    template <>
+    inline coda::string makeValue<coda::string>(uint32 i) { coda::string s; s.format("element {} of the array", i); return s; }
+
+    template <>
+    inline std::string makeValue<std::string>(uint32 i) { return "element " + std::to_string(i) + " of the array"; }
+
+    // adapters so every benchmark body is shared by both containers
+    template <typename T>
+    struct codaarray
+    {
+        dynarray<T> array;
+        void reserve(uint32 count) { array.reserve(count); }
+        void push(T&& value) { array.pushBack(std::move(value)); }
+        void push(const T& value) { array.pushBack(value); }
+        uint32 size() const { return array.getSize(); }
+    };
+
+    template <typename T>
+    struct stdarray
+    {
+        std::vector<T> array;
+        void reserve(uint32 count) { array.reserve(count); }
+        void push(T&& value) { array.push_back(std::move(value)); }
+        void push(const T& value) { array.push_back(value); }
+        uint32 size() const { return static_cast<uint32>(array.size()); }
+    };
+
+    // fills an array of arg elements per iteration, copying them from a prebuilt set
+    template <typename ArrayType, typename T, bool Reserve>
+    void arrayPushBack(bench::state& state)
+    {
+        const uint32 count = static_cast<uint32>(state.getArg());
+        state.pauseTiming();
+        std::vector<T>* values = new std::vector<T>();
+        for (uint32 i = 0; i < count; ++i)
+            values->push_back(makeValue<T>(i));
+        state.resumeTiming();
+        for (uint64 it = 0; it < state.getIterations(); ++it)
+        {
+            ArrayType* array = new ArrayType();
+            if (Reserve)
+                array->reserve(count);
+            for (uint32 i = 0; i < count; ++i)
+                array->push((*values)[i]);
+            bench::doNotOptimize(array->size());
+            state.pauseTiming();
+            delete array;
+            state.resumeTiming();
+        }
+        state.pauseTiming();
+        delete values;
+        state.resumeTiming();
+        state.setItemsProcessed(state.getIterations() * count);
+    }
+
+    CODA_BENCHMARK_NAMED("dynarray_pushBack<uint32>", (arrayPushBack<codaarray<uint32>, uint32, false>), 16, 1024, 65536);
+    CODA_BENCHMARK_NAMED("vector_push_back<uint32>", (arrayPushBack<stdarray<uint32>, uint32, false>), 16, 1024, 65536);
+    CODA_BENCHMARK_NAMED("dynarray_reservePushBack<uint32>", (arrayPushBack<codaarray<uint32>, uint32, true>), 16, 1024, 65536);
+    CODA_BENCHMARK_NAMED("vector_reservePushBack<uint32>", (arrayPushBack<stdarray<uint32>, uint32, true>), 16, 1024, 65536);
+    CODA_BENCHMARK_NAMED("dynarray_pushBack<string>", (arrayPushBack<codaarray<coda::string>, coda::string, false>), 16, 1024, 65536);
+    CODA_BENCHMARK_NAMED("vector_push_back<string>", (arrayPushBack<stdarray<std::string>, std::string, false>), 16, 1024, 65536);
+
+    // pushes arg elements then pops them all, the storage is reused between iterations
+    template <uint32 N>
+    void starrayPushPop(bench::state& state)
+    {
+        starray<uint32, N> array;
+        for (uint64 it = 0; it < state.getIterations(); ++it)
+        {
+            for (uint32 i = 0; i < N; ++i)
+                array.pushBack(i);
+            bench::doNotOptimize(array.getBack());
+            while (!array.isEmpty())
+                array.popBack();
+        }
+        state.setItemsProcessed(state.getIterations() * N);
+    }
+
+    template <uint32 N>
+    void vectorPushPop(bench::state& state)
+    {
+        std::vector<uint32> array;
+        array.reserve(N);
+        for (uint64 it = 0; it < state.getIterations(); ++it)
+        {
+            for (uint32 i = 0; i < N; ++i)
+                array.push_back(i);
+            bench::doNotOptimize(array.back());
+            while (!array.empty())
+                array.pop_back();
+        }
+        state.setItemsProcessed(state.getIterations() * N);
+    }
+
+    CODA_BENCHMARK_NAMED("starray_pushPop<16>", starrayPushPop<16>);
+    CODA_BENCHMARK_NAMED("vector_pushPop<16>", vectorPushPop<16>);
+    CODA_BENCHMARK_NAMED("starray_pushPop<1024>", starrayPushPop<1024>);
+    CODA_BENCHMARK_NAMED("vector_pushPop<1024>", vectorPushPop<1024>);
+
+    // builds and destroys a short list of arg elements per iteration, allocation included
+    template <typename ArrayType>
+    void shortList(bench::state& state)
+    {
+        const uint32 count = static_cast<uint32>(state.getArg());
+        for (uint64 it = 0; it < state.getIterations(); ++it)
+        {
+            ArrayType array;
+            for (uint32 i = 0; i < count; ++i)
+                array.push(i);
+            bench::doNotOptimize(array.size());
+        }
+        state.setItemsProcessed(state.getIterations() * count);
+    }
+
+    struct smallarray8
+    {
+        smallarray<uint32, 8> array;
+        void push(uint32 value) { array.pushBack(value); }
+        uint32 size() const { return array.getSize(); }
+    };
+
+    CODA_BENCHMARK_NAMED("smallarray_shortList<8>", shortList<smallarray8>, 4, 8, 16);
+    CODA_BENCHMARK_NAMED("dynarray_shortList", shortList<codaarray<uint32>>, 4, 8, 16);
+    CODA_BENCHMARK_NAMED("vector_shortList", shortList<stdarray<uint32>>, 4, 8, 16);
+}
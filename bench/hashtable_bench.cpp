@@ -0,0 +1,179 @@
+#include "bench.h"
+#include "hashtable.h"
+#include "codastring.h"
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+    using namespace coda;
+
+    // distinct keys, present ones from index 0 and missing ones from index count
+    template <typename KeyType>
+    inline KeyType makeKey(uint32 i) { return static_cast<KeyType>(i) * 0x9e3779b97f4a7c15ull; }
+
+    template <>
+    inline coda::string makeKey<coda::string>(uint32 i) { coda::string s; s.format("key:{}", i); return s; }
+
+    template <>
+    inline std::string makeKey<std::string>(uint32 i) { return "key:" + std::to_string(i); }
+
+    template <typename KeyType>
+    struct codatable
+    {
+        typedef KeyType key_type;
+        hashtable<KeyType, uint32> table{ 16 };
+        void insert(const KeyType& key, uint32 value) { table.createItem(key, value); }
+        bool find(const KeyType& key) const { return table.findItem(key) != nullptr; }
+        void erase(const KeyType& key) { table.destroyItem(key); }
+        uint64 sum() const
+        {
+            uint64 total = 0;
+            for (auto entry : table)
+                total += entry.item;
+            return total;
+        }
+    };
+
+    template <typename KeyType>
+    struct stdtable
+    {
+        typedef KeyType key_type;
+        std::unordered_map<KeyType, uint32> table;
+        void insert(const KeyType& key, uint32 value) { table.emplace(key, value); }
+        bool find(const KeyType& key) const { return table.find(key) != table.end(); }
+        void erase(const KeyType& key) { table.erase(key); }
+        uint64 sum() const
+        {
+            uint64 total = 0;
+            for (const auto& entry : table)
+                total += entry.second;
+            return total;
+        }
+    };
+
+    template <typename TableType>
+    std::vector<typename TableType::key_type> makeKeys(uint32 first, uint32 count)
+    {
+        std::vector<typename TableType::key_type> keys;
+        keys.reserve(count);
+        for (uint32 i = 0; i < count; ++i)
+            keys.push_back(makeKey<typename TableType::key_type>(first + i));
+        return keys;
+    }
+
+    // setup data, created and destroyed with the timing paused
+    template <typename TableType>
+    struct fixture
+    {
+        fixture(uint32 count, bool fill, bool missingLookups)
+            : keys(makeKeys<TableType>(0, count)), lookups(missingLookups ? makeKeys<TableType>(count, count) : keys)
+        {
+            if (fill)
+                for (uint32 i = 0; i < count; ++i)
+                    table.insert(keys[i], i);
+        }
+
+        std::vector<typename TableType::key_type> keys;
+        std::vector<typename TableType::key_type> lookups;
+        TableType table;
+    };
+
+    // builds a table of arg items from empty each iteration
+    template <typename TableType>
+    void tableInsert(bench::state& state)
+    {
+        const uint32 count = static_cast<uint32>(state.getArg());
+        state.pauseTiming();
+        fixture<TableType>* data = new fixture<TableType>(count, false, false);
+        state.resumeTiming();
+        for (uint64 it = 0; it < state.getIterations(); ++it)
+        {
+            TableType* table = new TableType();
+            for (uint32 i = 0; i < count; ++i)
+                table->insert(data->keys[i], i);
+            state.pauseTiming();
+            delete table;
+            state.resumeTiming();
+        }
+        state.pauseTiming();
+        delete data;
+        state.resumeTiming();
+        state.setItemsProcessed(state.getIterations() * count);
+    }
+
+    // looks up keys of a table of arg items, all present or all missing
+    template <typename TableType, bool Hit>
+    void tableFind(bench::state& state)
+    {
+        const uint32 count = static_cast<uint32>(state.getArg());
+        state.pauseTiming();
+        fixture<TableType>* data = new fixture<TableType>(count, true, !Hit);
+        state.resumeTiming();
+        uint32 found = 0;
+        uint32 i = 0;
+        for (uint64 it = 0; it < state.getIterations(); ++it)
+        {
+            found += data->table.find(data->lookups[i]);
+            i = i + 1 < count ? i + 1 : 0;
+        }
+        bench::doNotOptimize(found);
+        state.pauseTiming();
+        delete data;
+        state.resumeTiming();
+        state.setItemsProcessed(state.getIterations());
+    }
+
+    // erases every item of a table of arg items
+    template <typename TableType>
+    void tableErase(bench::state& state)
+    {
+        const uint32 count = static_cast<uint32>(state.getArg());
+        for (uint64 it = 0; it < state.getIterations(); ++it)
+        {
+            state.pauseTiming();
+            fixture<TableType>* data = new fixture<TableType>(count, true, false);
+            state.resumeTiming();
+            for (uint32 i = 0; i < count; ++i)
+                data->table.erase(data->keys[i]);
+            state.pauseTiming();
+            delete data;
+            state.resumeTiming();
+        }
+        state.setItemsProcessed(state.getIterations() * count);
+    }
+
+    // visits every item of a table of arg items
+    template <typename TableType>
+    void tableIterate(bench::state& state)
+    {
+        const uint32 count = static_cast<uint32>(state.getArg());
+        state.pauseTiming();
+        fixture<TableType>* data = new fixture<TableType>(count, true, false);
+        state.resumeTiming();
+        for (uint64 it = 0; it < state.getIterations(); ++it)
+            bench::doNotOptimize(data->table.sum());
+        state.pauseTiming();
+        delete data;
+        state.resumeTiming();
+        state.setItemsProcessed(state.getIterations() * count);
+    }
+
+#define HASHTABLE_BENCHMARKS(name, KeyType, StdKeyType) \
+    CODA_BENCHMARK_NAMED("hashtable_insert<" name ">", tableInsert<codatable<KeyType>>, 1 << 10, 1 << 16, 1 << 20); \
+    CODA_BENCHMARK_NAMED("unordered_map_insert<" name ">", tableInsert<stdtable<StdKeyType>>, 1 << 10, 1 << 16, 1 << 20); \
+    CODA_BENCHMARK_NAMED("hashtable_hit<" name ">", (tableFind<codatable<KeyType>, true>), 1 << 10, 1 << 16, 1 << 20); \
+    CODA_BENCHMARK_NAMED("unordered_map_hit<" name ">", (tableFind<stdtable<StdKeyType>, true>), 1 << 10, 1 << 16, 1 << 20); \
+    CODA_BENCHMARK_NAMED("hashtable_miss<" name ">", (tableFind<codatable<KeyType>, false>), 1 << 10, 1 << 16, 1 << 20); \
+    CODA_BENCHMARK_NAMED("unordered_map_miss<" name ">", (tableFind<stdtable<StdKeyType>, false>), 1 << 10, 1 << 16, 1 << 20); \
+    CODA_BENCHMARK_NAMED("hashtable_erase<" name ">", tableErase<codatable<KeyType>>, 1 << 10, 1 << 16, 1 << 20); \
+    CODA_BENCHMARK_NAMED("unordered_map_erase<" name ">", tableErase<stdtable<StdKeyType>>, 1 << 10, 1 << 16, 1 << 20); \
+    CODA_BENCHMARK_NAMED("hashtable_iterate<" name ">", tableIterate<codatable<KeyType>>, 1 << 10, 1 << 16, 1 << 20); \
+    CODA_BENCHMARK_NAMED("unordered_map_iterate<" name ">", tableIterate<stdtable<StdKeyType>>, 1 << 10, 1 << 16, 1 << 20)
+
+    HASHTABLE_BENCHMARKS("uint32", uint32, uint32);
+    HASHTABLE_BENCHMARKS("uint64", uint64, uint64);
+    HASHTABLE_BENCHMARKS("string", coda::string, std::string);
+}
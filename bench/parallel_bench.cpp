@@ -0,0 +1,117 @@
+#include "bench.h"
+#include "dynarray.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    using namespace coda;
+
+    dynarray<float> makeValues(uint32 count)
+    {
+        dynarray<float> values(count);
+        for (uint32 i = 0; i < count; ++i)
+            values.pushBack(static_cast<float>((i * 7919u) % 100003u));
+        return values;
+    }
+
+    // a few dozen cycles per element, enough to be bound by compute rather than memory
+    inline void updateElement(float& value)
+    {
+        for (uint32 i = 0; i < 8; ++i)
+            value = std::sqrt(value * 1.5f + 1.f);
+    }
+
+    void serial_for(bench::state& state)
+    {
+        dynarray<float> values = makeValues(static_cast<uint32>(state.getArg()));
+        for (uint64 it = 0; it < state.getIterations(); ++it)
+        {
+            for (float& value : values)
+                updateElement(value);
+            bench::doNotOptimize(values.getData());
+        }
+        state.setItemsProcessed(state.getIterations() * values.getSize());
+    }
+    CODA_BENCHMARK(serial_for, 1 << 16, 1 << 20);
+
+    void parallel_for(bench::state& state)
+    {
+        dynarray<float> values = makeValues(static_cast<uint32>(state.getArg()));
+        for (uint64 it = 0; it < state.getIterations(); ++it)
+        {
+            parallelFor(values.getSpan(), [](span<float> piece)
+                {
+                    for (float& value : piece)
+                        updateElement(value);
+                });
+            bench::doNotOptimize(values.getData());
+        }
+        state.setItemsProcessed(state.getIterations() * values.getSize());
+    }
+    CODA_BENCHMARK(parallel_for, 1 << 16, 1 << 20);
+
+    double sumValues(span<const float> values)
+    {
+        double sum = 0.0;
+        for (float value : values)
+            sum += value;
+        return sum;
+    }
+
+    void serial_reduce(bench::state& state)
+    {
+        dynarray<float> values = makeValues(static_cast<uint32>(state.getArg()));
+        for (uint64 it = 0; it < state.getIterations(); ++it)
+            bench::doNotOptimize(sumValues(values.getSpan()));
+        state.setItemsProcessed(state.getIterations() * values.getSize());
+    }
+    CODA_BENCHMARK(serial_reduce, 1 << 16, 1 << 22);
+
+    void parallel_reduce(bench::state& state)
+    {
+        dynarray<float> values = makeValues(static_cast<uint32>(state.getArg()));
+        for (uint64 it = 0; it < state.getIterations(); ++it)
+        {
+            double sum = parallelReduce(values.getSpan(), 0.0, [](span<float> piece) { return sumValues(piece); },
+                [](double a, double b) { return a + b; });
+            bench::doNotOptimize(sum);
+        }
+        state.setItemsProcessed(state.getIterations() * values.getSize());
+    }
+    CODA_BENCHMARK(parallel_reduce, 1 << 16, 1 << 22);
+
+    void serial_sort(bench::state& state)
+    {
+        dynarray<float> source = makeValues(static_cast<uint32>(state.getArg()));
+        dynarray<float> values;
+        for (uint64 it = 0; it < state.getIterations(); ++it)
+        {
+            state.pauseTiming();
+            values = source;
+            state.resumeTiming();
+            std::sort(values.begin(), values.end());
+            bench::doNotOptimize(values.getData());
+        }
+        state.setItemsProcessed(state.getIterations() * source.getSize());
+    }
+    CODA_BENCHMARK(serial_sort, 1 << 16, 1 << 20);
+
+    void parallel_sort(bench::state& state)
+    {
+        dynarray<float> source = makeValues(static_cast<uint32>(state.getArg()));
+        dynarray<float> values;
+        for (uint64 it = 0; it < state.getIterations(); ++it)
+        {
+            state.pauseTiming();
+            values = source;
+            state.resumeTiming();
+            parallelSort(values.getSpan());
+            bench::doNotOptimize(values.getData());
+        }
+        state.setItemsProcessed(state.getIterations() * source.getSize());
+    }
+    CODA_BENCHMARK(parallel_sort, 1 << 16, 1 << 20);
+}
@@ -0,0 +1,147 @@
+#include "bench.h"
+#include "dynarray.h"
+#include "simd.h"
+
+namespace
+{
+    using namespace coda;
+
+    template <typename T>
+    dynarray<T> makeValues(uint32 count)
+    {
+        dynarray<T> values(count);
+        for (uint32 i = 0; i < count; ++i)
+            values.pushBack(static_cast<T>((i * 37) % 1001));
+        return values;
+    }
+
+    // the hand written loops simd replaces, through the checked operator[]
+    template <typename T>
+    void loopSum(bench::state& state)
+    {
+        dynarray<T> values = makeValues<T>(static_cast<uint32>(state.getArg()));
+        for (uint64 it = 0; it < state.getIterations(); ++it)
+        {
+            T sum = 0;
+            for (uint32 i = 0; i < values.getSize(); ++i)
+                sum += values[i];
+            bench::doNotOptimize(sum);
+        }
+        state.setItemsProcessed(state.getIterations() * values.getSize());
+    }
+
+    template <typename T>
+    void simdSum(bench::state& state)
+    {
+        dynarray<T> values = makeValues<T>(static_cast<uint32>(state.getArg()));
+        for (uint64 it = 0; it < state.getIterations(); ++it)
+            bench::doNotOptimize(simd::sum(values.getSpan()));
+        state.setItemsProcessed(state.getIterations() * values.getSize());
+    }
+
+    void loop_maxFloat(bench::state& state)
+    {
+        dynarray<float> values = makeValues<float>(static_cast<uint32>(state.getArg()));
+        for (uint64 it = 0; it < state.getIterations(); ++it)
+        {
+            float result = values[0];
+            for (uint32 i = 1; i < values.getSize(); ++i)
+                result = values[i] > result ? values[i] : result;
+            bench::doNotOptimize(result);
+        }
+        state.setItemsProcessed(state.getIterations() * values.getSize());
+    }
+
+    void simd_maxFloat(bench::state& state)
+    {
+        dynarray<float> values = makeValues<float>(static_cast<uint32>(state.getArg()));
+        for (uint64 it = 0; it < state.getIterations(); ++it)
+            bench::doNotOptimize(simd::maximum(values.getSpan()));
+        state.setItemsProcessed(state.getIterations() * values.getSize());
+    }
+
+    // looks for a value that is not there, scanning the whole array
+    void loop_findUint32(bench::state& state)
+    {
+        dynarray<uint32> values = makeValues<uint32>(static_cast<uint32>(state.getArg()));
+        for (uint64 it = 0; it < state.getIterations(); ++it)
+        {
+            uint32 found = simd::invalidIndex;
+            for (uint32 i = 0; i < values.getSize(); ++i)
+            {
+                if (values[i] == 5000)
+                {
+                    found = i;
+                    break;
+                }
+            }
+            bench::doNotOptimize(found);
+        }
+        state.setItemsProcessed(state.getIterations() * values.getSize());
+    }
+
+    void simd_findUint32(bench::state& state)
+    {
+        dynarray<uint32> values = makeValues<uint32>(static_cast<uint32>(state.getArg()));
+        for (uint64 it = 0; it < state.getIterations(); ++it)
+            bench::doNotOptimize(simd::find(values.getSpan(), 5000u));
+        state.setItemsProcessed(state.getIterations() * values.getSize());
+    }
+
+    void loop_countFloat(bench::state& state)
+    {
+        dynarray<float> values = makeValues<float>(static_cast<uint32>(state.getArg()));
+        for (uint64 it = 0; it < state.getIterations(); ++it)
+        {
+            uint32 count = 0;
+            for (uint32 i = 0; i < values.getSize(); ++i)
+                count += values[i] == 10.f;
+            bench::doNotOptimize(count);
+        }
+        state.setItemsProcessed(state.getIterations() * values.getSize());
+    }
+
+    void simd_countFloat(bench::state& state)
+    {
+        dynarray<float> values = makeValues<float>(static_cast<uint32>(state.getArg()));
+        for (uint64 it = 0; it < state.getIterations(); ++it)
+            bench::doNotOptimize(simd::count(values.getSpan(), 10.f));
+        state.setItemsProcessed(state.getIterations() * values.getSize());
+    }
+
+    void loop_fillFloat(bench::state& state)
+    {
+        dynarray<float> values = makeValues<float>(static_cast<uint32>(state.getArg()));
+        for (uint64 it = 0; it < state.getIterations(); ++it)
+        {
+            for (uint32 i = 0; i < values.getSize(); ++i)
+                new (&values[i]) float(1.5f);
+            bench::doNotOptimize(values.getData());
+        }
+        state.setItemsProcessed(state.getIterations() * values.getSize());
+    }
+
+    void dynarray_fillFloat(bench::state& state)
+    {
+        dynarray<float> values = makeValues<float>(static_cast<uint32>(state.getArg()));
+        for (uint64 it = 0; it < state.getIterations(); ++it)
+        {
+            values.fill(1.5f, 0, values.getSize());
+            bench::doNotOptimize(values.getData());
+        }
+        state.setItemsProcessed(state.getIterations() * values.getSize());
+    }
+
+    CODA_BENCHMARK_NAMED("loop_sumFloat", loopSum<float>, 1 << 10, 1 << 16);
+    CODA_BENCHMARK_NAMED("simd_sumFloat", simdSum<float>, 1 << 10, 1 << 16);
+    CODA_BENCHMARK_NAMED("loop_sumUint32", loopSum<uint32>, 1 << 10, 1 << 16);
+    CODA_BENCHMARK_NAMED("simd_sumUint32", simdSum<uint32>, 1 << 10, 1 << 16);
+    CODA_BENCHMARK(loop_maxFloat, 1 << 10, 1 << 16);
+    CODA_BENCHMARK(simd_maxFloat, 1 << 10, 1 << 16);
+    CODA_BENCHMARK(loop_findUint32, 1 << 10, 1 << 16);
+    CODA_BENCHMARK(simd_findUint32, 1 << 10, 1 << 16);
+    CODA_BENCHMARK(loop_countFloat, 1 << 10, 1 << 16);
+    CODA_BENCHMARK(simd_countFloat, 1 << 10, 1 << 16);
+    CODA_BENCHMARK(loop_fillFloat, 1 << 10, 1 << 16);
+    CODA_BENCHMARK(dynarray_fillFloat, 1 << 10, 1 << 16);
+}
@@ -0,0 +1,112 @@
+#include "bench.h"
+#include "dynarray.h"
+#include "soaarray.h"
+
+namespace
+{
+    using namespace coda;
+
+    struct particle
+    {
+        float x, y, z;
+        float vx, vy, vz;
+        float life;
+        uint32 id;
+    };
+
+    typedef soaarray<float, float, float, float, float, float, float, uint32> particlecolumns;
+    enum { fieldX, fieldY, fieldZ, fieldVX, fieldVY, fieldVZ, fieldLife, fieldId };
+
+    void fillParticles(dynarray<particle>& particles, uint32 count)
+    {
+        for (uint32 i = 0; i < count; ++i)
+        {
+            float f = static_cast<float>(i);
+            particles.pushBack(particle{ f, f, f, 1.f, 2.f, 3.f, f * 0.5f, i });
+        }
+    }
+
+    void fillParticles(particlecolumns& particles, uint32 count)
+    {
+        for (uint32 i = 0; i < count; ++i)
+        {
+            float f = static_cast<float>(i);
+            particles.pushBack(f, f, f, 1.f, 2.f, 3.f, f * 0.5f, i);
+        }
+    }
+
+    // sums a single field of arg particles, an integer one since float sums only vectorize with -ffast-math
+    void dynarray_sumField(bench::state& state)
+    {
+        dynarray<particle> particles;
+        fillParticles(particles, static_cast<uint32>(state.getArg()));
+        for (uint64 it = 0; it < state.getIterations(); ++it)
+        {
+            uint32 sum = 0;
+            for (const particle& p : particles)
+                sum += p.id;
+            bench::doNotOptimize(sum);
+        }
+        state.setItemsProcessed(state.getIterations() * particles.getSize());
+    }
+    CODA_BENCHMARK(dynarray_sumField, 1 << 12, 1 << 16, 1 << 20);
+
+    void soaarray_sumField(bench::state& state)
+    {
+        particlecolumns particles;
+        fillParticles(particles, static_cast<uint32>(state.getArg()));
+        for (uint64 it = 0; it < state.getIterations(); ++it)
+        {
+            uint32 sum = 0;
+            for (uint32 id : particles.getColumn<fieldId>())
+                sum += id;
+            bench::doNotOptimize(sum);
+        }
+        state.setItemsProcessed(state.getIterations() * particles.getSize());
+    }
+    CODA_BENCHMARK(soaarray_sumField, 1 << 12, 1 << 16, 1 << 20);
+
+    // moves arg particles along their velocity, reads and writes half of the fields
+    void dynarray_integrate(bench::state& state)
+    {
+        dynarray<particle> particles;
+        fillParticles(particles, static_cast<uint32>(state.getArg()));
+        for (uint64 it = 0; it < state.getIterations(); ++it)
+        {
+            for (particle& p : particles)
+            {
+                p.x += p.vx * 0.016f;
+                p.y += p.vy * 0.016f;
+                p.z += p.vz * 0.016f;
+            }
+            bench::doNotOptimize(particles.getData());
+        }
+        state.setItemsProcessed(state.getIterations() * particles.getSize());
+    }
+    CODA_BENCHMARK(dynarray_integrate, 1 << 12, 1 << 16, 1 << 20);
+
+    void soaarray_integrate(bench::state& state)
+    {
+        particlecolumns particles;
+        fillParticles(particles, static_cast<uint32>(state.getArg()));
+        const uint32 count = particles.getSize();
+        for (uint64 it = 0; it < state.getIterations(); ++it)
+        {
+            float* x = particles.getData<fieldX>();
+            float* y = particles.getData<fieldY>();
+            float* z = particles.getData<fieldZ>();
+            const float* vx = particles.getData<fieldVX>();
+            const float* vy = particles.getData<fieldVY>();
+            const float* vz = particles.getData<fieldVZ>();
+            for (uint32 i = 0; i < count; ++i)
+            {
+                x[i] += vx[i] * 0.016f;
+                y[i] += vy[i] * 0.016f;
+                z[i] += vz[i] * 0.016f;
+            }
+            bench::doNotOptimize(x);
+        }
+        state.setItemsProcessed(state.getIterations() * count);
+    }
+    CODA_BENCHMARK(soaarray_integrate, 1 << 12, 1 << 16, 1 << 20);
+}
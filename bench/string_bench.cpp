@@ -0,0 +1,149 @@
+#include "bench.h"
+#include "codastring.h"
+
+#include <cstdio>
+#include <string>
+
+namespace
+{
+    using namespace coda;
+
+    // arg is the length of the strings, 16 stays in the inline buffers of both types
+    static const char* getSource(int64 length)
+    {
+        static char source[4096];
+        if (!source[0])
+        {
+            for (size_t i = 0; i < sizeof(source) - 1; ++i)
+                source[i] = static_cast<char>('a' + i % 26);
+        }
+        static char text[4096];
+        memcpy(text, source, static_cast<size_t>(length));
+        text[length] = 0;
+        return text;
+    }
+
+    void string_set(bench::state& state)
+    {
+        const char* text = getSource(state.getArg());
+        coda::string str;
+        for (uint64 i = 0; i < state.getIterations(); ++i)
+        {
+            str.set(text);
+            bench::doNotOptimize(str.c_str());
+        }
+        state.setItemsProcessed(state.getIterations());
+    }
+    CODA_BENCHMARK(string_set, 16, 256, 4000);
+
+    void stdstring_assign(bench::state& state)
+    {
+        const char* text = getSource(state.getArg());
+        std::string str;
+        for (uint64 i = 0; i < state.getIterations(); ++i)
+        {
+            str.assign(text);
+            bench::doNotOptimize(str.c_str());
+        }
+        state.setItemsProcessed(state.getIterations());
+    }
+    CODA_BENCHMARK(stdstring_assign, 16, 256, 4000);
+
+    // copy constructs a new string each iteration
+    void string_copy(bench::state& state)
+    {
+        coda::string source(getSource(state.getArg()));
+        for (uint64 i = 0; i < state.getIterations(); ++i)
+        {
+            coda::string copy(source);
+            bench::doNotOptimize(copy.c_str());
+        }
+        state.setItemsProcessed(state.getIterations());
+    }
+    CODA_BENCHMARK(string_copy, 16, 256, 4000);
+
+    void stdstring_copy(bench::state& state)
+    {
+        std::string source(getSource(state.getArg()));
+        for (uint64 i = 0; i < state.getIterations(); ++i)
+        {
+            std::string copy(source);
+            bench::doNotOptimize(copy.c_str());
+        }
+        state.setItemsProcessed(state.getIterations());
+    }
+    CODA_BENCHMARK(stdstring_copy, 16, 256, 4000);
+
+    // equal contents in different buffers, the worst case of a compare
+    void string_compare(bench::state& state)
+    {
+        coda::string a(getSource(state.getArg()));
+        coda::string b(getSource(state.getArg()));
+        uint32 equal = 0;
+        for (uint64 i = 0; i < state.getIterations(); ++i)
+        {
+            bench::doNotOptimize(a);
+            equal += a == b;
+        }
+        bench::doNotOptimize(equal);
+        state.setItemsProcessed(state.getIterations());
+    }
+    CODA_BENCHMARK(string_compare, 16, 256, 4000);
+
+    void stdstring_compare(bench::state& state)
+    {
+        std::string a(getSource(state.getArg()));
+        std::string b(getSource(state.getArg()));
+        uint32 equal = 0;
+        for (uint64 i = 0; i < state.getIterations(); ++i)
+        {
+            bench::doNotOptimize(a);
+            equal += a == b;
+        }
+        bench::doNotOptimize(equal);
+        state.setItemsProcessed(state.getIterations());
+    }
+    CODA_BENCHMARK(stdstring_compare, 16, 256, 4000);
+
+    // a typical log line, reusing the string
+    void string_setFmt(bench::state& state)
+    {
+        coda::string str;
+        for (uint64 i = 0; i < state.getIterations(); ++i)
+        {
+            str.setFmt("[%s] request %u took %.3f ms", "info", static_cast<uint32>(i), 1.25);
+            bench::doNotOptimize(str.c_str());
+        }
+        state.setItemsProcessed(state.getIterations());
+    }
+    CODA_BENCHMARK(string_setFmt);
+
+    void string_format(bench::state& state)
+    {
+        coda::string str;
+        for (uint64 i = 0; i < state.getIterations(); ++i)
+        {
+            str.format("[{}] request {} took {} ms", "info", static_cast<uint32>(i), 1.25);
+            bench::doNotOptimize(str.c_str());
+        }
+        state.setItemsProcessed(state.getIterations());
+    }
+    CODA_BENCHMARK(string_format);
+
+    void stdstring_format(bench::state& state)
+    {
+        std::string str;
+        for (uint64 i = 0; i < state.getIterations(); ++i)
+        {
+            str.clear();
+            str += "[info] request ";
+            str += std::to_string(static_cast<uint32>(i));
+            str += " took ";
+            str += std::to_string(1.25);
+            str += " ms";
+            bench::doNotOptimize(str.c_str());
+        }
+        state.setItemsProcessed(state.getIterations());
+    }
+    CODA_BENCHMARK(stdstring_format);
+}
@@ -1,8 +1,39 @@
 #include "allocator.h"
 #include <cstdlib>
+#include <cstring>
+#ifdef _MSC_VER
+#include <malloc.h>
+#endif
 
 namespace coda
 {
+#ifdef _MSC_VER
+    // Aligned blocks can't be given to free on windows, every block goes through _aligned_malloc
+    void* baseallocator::allocate(size_t size)
+    {
+        return _aligned_malloc(size, defaultAlignment);
+    }
+
+    void* baseallocator::reallocate(void* p, size_t size)
+    {
+        return _aligned_realloc(p, size, defaultAlignment);
+    }
+
+    void baseallocator::release(void* p)
+    {
+        _aligned_free(p);
+    }
+
+    void* baseallocator::allocate(size_t size, size_t alignment)
+    {
+        return _aligned_malloc(size, alignment > defaultAlignment ? alignment : defaultAlignment);
+    }
+
+    void* baseallocator::reallocate(void* p, size_t size, size_t alignment)
+    {
+        return _aligned_realloc(p, size, alignment > defaultAlignment ? alignment : defaultAlignment);
+    }
+#else
     void* baseallocator::allocate(size_t size)
     {
         return malloc(size);
@@ -17,4 +48,26 @@ namespace coda
     {
         free(p);
     }
+
+    void* baseallocator::allocate(size_t size, size_t alignment)
+    {
+        if (alignment <= defaultAlignment)
+            return malloc(size);
+        void* p = nullptr;
+        return posix_memalign(&p, alignment, size) == 0 ? p : nullptr;
+    }
+
+    void* baseallocator::reallocate(void* p, size_t size, size_t alignment)
+    {
+        // realloc keeps the alignment most of the times, copy to a new aligned block otherwise
+        void* newBlock = realloc(p, size);
+        if (!newBlock || !(reinterpret_cast<uintptr_t>(newBlock) & (alignment - 1)))
+            return newBlock;
+        void* aligned = allocate(size, alignment);
+        if (aligned)
+            memcpy(aligned, newBlock, size);
+        free(newBlock);
+        return aligned;
+    }
+#endif
 }
@@ -1,14 +1,176 @@
 #pragma once
 
 #include "common.h"
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <utility>
+
+// Minimum alignment of the storage of dynarray, smallarray, hashtable... 64 keeps every block on its
+// own cache lines, padding its size too. 0 only follows alignof of the elements.
+#ifndef CODA_STORAGE_ALIGNMENT
+#define CODA_STORAGE_ALIGNMENT 0
+#endif
 
 namespace coda
 {
+    // Alignment of every block from an allocator, bigger ones need the alignment overloads
+    static constexpr size_t defaultAlignment = alignof(std::max_align_t);
+
+    /**
+     * Allocator policy over malloc. The alignment overloads return blocks aligned to any power of
+     * two, which are reallocated and released like the others. Reallocating an aligned block copies
+     * it when realloc moves it to a misaligned address.
+     */
     class baseallocator
     {
     public:
         static void* allocate(size_t size);
         static void* reallocate(void* p, size_t size);
         static void release(void* p);
+
+        static void* allocate(size_t size, size_t alignment);
+        static void* reallocate(void* p, size_t size, size_t alignment);
+    };
+
+    /**
+     * Allocator instance stored by the containers. Containers derive from it so stateless allocators
+     * (like the static policies) take no space, stateful ones are stored by value.
+     */
+    template <typename AllocatorType, bool IsEmpty = std::is_empty<AllocatorType>::value>
+    class allocatorholder : private AllocatorType
+    {
+    public:
+        allocatorholder() = default;
+        explicit allocatorholder(const AllocatorType& allocator) : AllocatorType(allocator) {}
+
+        AllocatorType& getAllocator() { return *this; }
+        const AllocatorType& getAllocator() const { return *this; }
+    };
+
+    template <typename AllocatorType>
+    class allocatorholder<AllocatorType, false>
+    {
+    public:
+        allocatorholder() = default;
+        explicit allocatorholder(const AllocatorType& allocator) : m_allocator(allocator) {}
+
+        AllocatorType& getAllocator() { return m_allocator; }
+        const AllocatorType& getAllocator() const { return m_allocator; }
+
+    private:
+        AllocatorType m_allocator;
+    };
+
+    /**
+     * Types whose objects can be moved to another address with a plain memcpy, leaving nothing to
+     * destroy at the old one. Containers relocate them with realloc instead of move+destroy.
+     * Specialize it for types holding no pointers into themselves.
+     */
+    template <typename T>
+    struct is_trivially_relocatable : std::is_trivially_copyable<T> {};
+
+    /**
+     * Stateful allocator forwarding to a resource owned elsewhere (an arena, a pool...), which must
+     * outlive every container using it.
+     */
+    template <typename ResourceType>
+    class allocatorref
+    {
+    public:
+        allocatorref(ResourceType& _resource) : resource(&_resource) {}
+
+        void* allocate(size_t size) const { return resource->allocate(size); }
+        void* reallocate(void* p, size_t size) const { return resource->reallocate(p, size); }
+        void release(void* p) const { resource->release(p); }
+
+        // Only there when the resource has them
+        template <typename R = ResourceType>
+        auto allocate(size_t size, size_t alignment) const -> decltype(std::declval<R&>().allocate(size, alignment))
+        {
+            return resource->allocate(size, alignment);
+        }
+        template <typename R = ResourceType>
+        auto reallocate(void* p, size_t size, size_t alignment) const -> decltype(std::declval<R&>().reallocate(p, size, alignment))
+        {
+            return resource->reallocate(p, size, alignment);
+        }
+
+        ResourceType& getResource() const { return *resource; }
+
+    private:
+        ResourceType* resource;
     };
-}
\ No newline at end of file
+
+    // Storage alignment containers use for T, see CODA_STORAGE_ALIGNMENT
+    template <typename T>
+    struct storage_alignment : std::integral_constant<size_t, (alignof(T) > CODA_STORAGE_ALIGNMENT ? alignof(T) : CODA_STORAGE_ALIGNMENT)> {};
+
+    template <typename AllocatorType, typename = void>
+    struct has_aligned_allocate : std::false_type {};
+
+    template <typename AllocatorType>
+    struct has_aligned_allocate<AllocatorType, decltype(void(std::declval<AllocatorType&>().allocate(size_t(), size_t())),
+        void(std::declval<AllocatorType&>().reallocate(nullptr, size_t(), size_t())))> : std::true_type {};
+
+    /**
+     * Aligned blocks from any allocator. Alignments up to defaultAlignment go to the plain calls,
+     * bigger ones to the alignment overloads when the allocator has them. Otherwise the block is
+     * over-allocated and the pointer to release is stored right before the aligned address, so
+     * blocks must be reallocated and released with the same alignment they were allocated with.
+     * Over-aligned sizes are padded to a multiple of the alignment, no other block shares their
+     * last cache line.
+     */
+    template <typename AllocatorType>
+    void* allocateAligned(AllocatorType& allocator, size_t size, size_t alignment)
+    {
+        coda_dbg_assert(alignment && !(alignment & (alignment - 1)));
+        if (alignment <= defaultAlignment)
+            return allocator.allocate(size);
+        size = (size + alignment - 1) & ~(alignment - 1);
+        if constexpr (has_aligned_allocate<AllocatorType>::value)
+        {
+            return allocator.allocate(size, alignment);
+        }
+        else
+        {
+            byte* block = static_cast<byte*>(allocator.allocate(size + alignment));
+            if (!block)
+                return nullptr;
+            uintptr_t aligned = (reinterpret_cast<uintptr_t>(block + sizeof(void*)) + alignment - 1) & ~static_cast<uintptr_t>(alignment - 1);
+            reinterpret_cast<void**>(aligned)[-1] = block;
+            return reinterpret_cast<void*>(aligned);
+        }
+    }
+
+    template <typename AllocatorType>
+    void releaseAligned(AllocatorType& allocator, void* p, size_t alignment)
+    {
+        if (alignment <= defaultAlignment || has_aligned_allocate<AllocatorType>::value || !p)
+            allocator.release(p);
+        else
+            allocator.release(static_cast<void**>(p)[-1]);
+    }
+
+    // oldSize is only used to copy blocks of allocators without alignment overloads
+    template <typename AllocatorType>
+    void* reallocateAligned(AllocatorType& allocator, void* p, size_t oldSize, size_t size, size_t alignment)
+    {
+        if (alignment <= defaultAlignment)
+            return allocator.reallocate(p, size);
+        if constexpr (has_aligned_allocate<AllocatorType>::value)
+        {
+            return allocator.reallocate(p, (size + alignment - 1) & ~(alignment - 1), alignment);
+        }
+        else
+        {
+            void* newBlock = allocateAligned(allocator, size, alignment);
+            if (newBlock && p)
+            {
+                memcpy(newBlock, p, oldSize < size ? oldSize : size);
+                releaseAligned(allocator, p, alignment);
+            }
+            return newBlock;
+        }
+    }
+}
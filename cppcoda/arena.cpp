@@ -0,0 +1,166 @@
+#include "arena.h"
+#include <cstring>
+
+namespace coda
+{
+    struct arena::chunk
+    {
+        chunk* prev;
+        size_t size;
+    };
+
+    // Precedes every block, keeps the size so blocks can be copied on reallocate
+    struct blockheader
+    {
+        size_t size;
+        // from the start of the block, header and alignment padding included
+        size_t offset;
+    };
+
+    static_assert(sizeof(blockheader) % arena::alignment == 0, "block header breaks the alignment");
+
+    static inline size_t alignSize(size_t size)
+    {
+        return (size + arena::alignment - 1) & ~(arena::alignment - 1);
+    }
+
+    static inline blockheader* getHeader(void* p)
+    {
+        return reinterpret_cast<blockheader*>(static_cast<byte*>(p) - sizeof(blockheader));
+    }
+
+    arena::arena(size_t _chunkSize)
+        : current(nullptr), cursor(nullptr), end(nullptr), last(nullptr), chunkSize(_chunkSize), used(0), reserved(0)
+    {
+        coda_assert(chunkSize > sizeof(chunk) + sizeof(blockheader));
+    }
+
+    arena::~arena()
+    {
+        while (current)
+        {
+            chunk* prev = current->prev;
+            baseallocator::release(current);
+            current = prev;
+        }
+    }
+
+    // Bytes from cursor to the first address aligned to blockAlignment with room for a header
+    static inline size_t getBlockOffset(const byte* cursor, size_t blockAlignment)
+    {
+        uintptr_t start = reinterpret_cast<uintptr_t>(cursor) + sizeof(blockheader);
+        return sizeof(blockheader) + ((blockAlignment - (start & (blockAlignment - 1))) & (blockAlignment - 1));
+    }
+
+    void* arena::allocate(size_t size)
+    {
+        return allocate(size, alignment);
+    }
+
+    void* arena::allocate(size_t size, size_t blockAlignment)
+    {
+        coda_dbg_assert(blockAlignment && !(blockAlignment & (blockAlignment - 1)));
+        if (blockAlignment < alignment)
+            blockAlignment = alignment;
+        size_t offset = getBlockOffset(cursor, blockAlignment);
+        size_t blockSize = offset + alignSize(size);
+        if (static_cast<size_t>(end - cursor) < blockSize)
+        {
+            // chunks start aligned to arena::alignment, enough for the worst padding
+            addChunk(sizeof(blockheader) + blockAlignment - alignment + alignSize(size));
+            offset = getBlockOffset(cursor, blockAlignment);
+            blockSize = offset + alignSize(size);
+        }
+
+        last = cursor + offset;
+        blockheader* header = getHeader(last);
+        header->size = size;
+        header->offset = offset;
+        cursor += blockSize;
+        used += blockSize;
+        return last;
+    }
+
+    void* arena::reallocate(void* p, size_t size)
+    {
+        return reallocate(p, size, alignment);
+    }
+
+    void* arena::reallocate(void* p, size_t size, size_t blockAlignment)
+    {
+        if (!p)
+            return allocate(size, blockAlignment);
+
+        blockheader* header = getHeader(p);
+        if (p == last)
+        {
+            byte* blockEnd = static_cast<byte*>(p) + alignSize(size);
+            if (blockEnd <= end)
+            {
+                if (blockEnd > cursor)
+                    used += static_cast<size_t>(blockEnd - cursor);
+                else
+                    used -= static_cast<size_t>(cursor - blockEnd);
+                cursor = blockEnd;
+                header->size = size;
+                return p;
+            }
+        }
+        else if (size <= header->size)
+        {
+            // not the last block, it can only shrink in place
+            header->size = size;
+            return p;
+        }
+
+        size_t oldSize = header->size;
+        void* newBlock = allocate(size, blockAlignment);
+        memcpy(newBlock, p, oldSize < size ? oldSize : size);
+        return newBlock;
+    }
+
+    void arena::release(void* p)
+    {
+        if (p && p == last)
+        {
+            byte* blockStart = static_cast<byte*>(p) - getHeader(p)->offset;
+            used -= static_cast<size_t>(cursor - blockStart);
+            cursor = blockStart;
+            last = nullptr;
+        }
+    }
+
+    void arena::reset()
+    {
+        if (!current)
+            return;
+        // keep the newest chunk, the older ones are usually smaller
+        while (current->prev)
+        {
+            chunk* prev = current->prev->prev;
+            reserved -= current->prev->size;
+            baseallocator::release(current->prev);
+            current->prev = prev;
+        }
+        cursor = reinterpret_cast<byte*>(current) + alignSize(sizeof(chunk));
+        end = reinterpret_cast<byte*>(current) + current->size;
+        last = nullptr;
+        used = 0;
+    }
+
+    void arena::addChunk(size_t minSize)
+    {
+        size_t size = alignSize(sizeof(chunk)) + minSize;
+        if (size < chunkSize)
+            size = chunkSize;
+        chunk* c = static_cast<chunk*>(baseallocator::allocate(size));
+        coda_assert(c);
+        c->prev = current;
+        c->size = size;
+        current = c;
+        reserved += size;
+        cursor = reinterpret_cast<byte*>(c) + alignSize(sizeof(chunk));
+        end = reinterpret_cast<byte*>(c) + size;
+        last = nullptr;
+    }
+}
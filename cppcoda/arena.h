@@ -0,0 +1,83 @@
+#pragma once
+
+#include "common.h"
+#include "allocator.h"
+
+namespace coda
+{
+    /**
+     * Linear allocator. Blocks are carved from large chunks by bumping a pointer and are only given
+     * back all at once with reset(), except the last allocated block which can also grow, shrink
+     * and be released in place.
+     */
+    class arena
+    {
+    public:
+        static constexpr size_t defaultChunkSize = 64 * 1024;
+        // Every block is aligned to this
+        static constexpr size_t alignment = 16;
+
+        arena(size_t _chunkSize = defaultChunkSize);
+        ~arena();
+
+        arena(const arena&) = delete;
+        arena& operator=(const arena&) = delete;
+
+        void* allocate(size_t size);
+        // In place for the last allocated block when it fits in its chunk, copy otherwise
+        void* reallocate(void* p, size_t size);
+        // Blocks aligned to blockAlignment, padding the chunk up to it
+        void* allocate(size_t size, size_t blockAlignment);
+        void* reallocate(void* p, size_t size, size_t blockAlignment);
+        // Only the last allocated block gives its memory back
+        void release(void* p);
+
+        // Releases every block, the newest chunk is kept for later allocations
+        void reset();
+
+        // Bytes handed out since the last reset, headers and padding included
+        size_t getUsedBytes() const { return used; }
+        size_t getReservedBytes() const { return reserved; }
+
+    private:
+        struct chunk;
+
+        void addChunk(size_t minSize);
+
+    private:
+        chunk* current;
+        byte* cursor;
+        byte* end;
+        byte* last;
+        size_t chunkSize;
+        size_t used;
+        size_t reserved;
+    };
+
+    // Stateful allocator handing out blocks of an arena owned by the caller
+    typedef allocatorref<arena> arenaref;
+
+    /**
+     * AllocatorType policy serving allocations from an arena owned by the calling thread.
+     * Containers using it must be gone before reset() is called. Use different tags to get
+     * independent arenas.
+     */
+    template <typename Tag = void>
+    class arenaallocator
+    {
+    public:
+        static void* allocate(size_t size) { return getArena().allocate(size); }
+        static void* reallocate(void* p, size_t size) { return getArena().reallocate(p, size); }
+        static void release(void* p) { getArena().release(p); }
+        static void* allocate(size_t size, size_t alignment) { return getArena().allocate(size, alignment); }
+        static void* reallocate(void* p, size_t size, size_t alignment) { return getArena().reallocate(p, size, alignment); }
+
+        static void reset() { getArena().reset(); }
+
+        static arena& getArena()
+        {
+            thread_local arena instance;
+            return instance;
+        }
+    };
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include "common.h"
+#include "allocator.h"
+#include "simdfill.h"
+#include "span.h"
+#include <cstring>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace coda
+{
+    /**
+     * Element operations shared by the contiguous arrays (dynarray, smallarray) over raw storage,
+     * the arrays only decide where the storage lives and when it grows. Trivially relocatable
+     * types are shifted and relocated with memmove/memcpy.
+     */
+    namespace arrayops
+    {
+        template <typename T, typename... Args>
+        void construct(T* p, Args&&... args)
+        {
+            new(p)T(std::forward<Args>(args)...);
+        }
+
+        // New elements are value initialized
+        template <typename T>
+        void construct(T* data, uint32 first, uint32 last)
+        {
+            for (uint32 i = first; i < last; ++i)
+                new(&data[i])T();
+        }
+
+        template <typename T>
+        void copy(T* data, const T* source, uint32 count)
+        {
+            for (uint32 i = 0; i < count; ++i)
+                new(&data[i])T(source[i]);
+        }
+
+        template <typename T>
+        void destroy(T* p)
+        {
+            p->~T();
+        }
+
+        template <typename T>
+        void destroy(T* data, uint32 first, uint32 last)
+        {
+            for (uint32 i = first; i < last; ++i)
+                data[i].~T();
+        }
+
+        // Moves count elements to the uninitialized to, leaving nothing to destroy in from
+        template <typename T>
+        void relocate(T* from, T* to, uint32 count)
+        {
+            if constexpr (is_trivially_relocatable<T>::value)
+            {
+                if (count)
+                    memcpy(static_cast<void*>(to), static_cast<const void*>(from), count * sizeof(T));
+            }
+            else
+            {
+                for (uint32 i = 0; i < count; ++i)
+                {
+                    new(&to[i])T(std::move(from[i]));
+                    from[i].~T();
+                }
+            }
+        }
+
+        // Vector stores or memset for trivially copyable types, see simd::fill
+        template <typename T>
+        void fill(T* data, uint32 count, const T& value)
+        {
+            if constexpr (std::is_trivially_copyable<T>::value)
+            {
+                simd::fill(span<T>(data, count), value);
+            }
+            else
+            {
+                for (uint32 i = 0; i < count; ++i)
+                    data[i] = value;
+            }
+        }
+
+        // Moves the size - index elements from index on one position up and puts value at index,
+        // the storage must have room for size + 1 elements
+        template <typename T>
+        void insert(T* data, uint32 size, uint32 index, T&& value)
+        {
+            coda_dbg_assert(index < size);
+            if constexpr (is_trivially_relocatable<T>::value)
+            {
+                memmove(static_cast<void*>(&data[index + 1]), static_cast<const void*>(&data[index]), (size - index) * sizeof(T));
+                new(&data[index])T(std::move(value));
+            }
+            else
+            {
+                new(&data[size])T(std::move(data[size - 1]));
+                for (uint32 i = size - 1; i > index; --i)
+                    data[i] = std::move(data[i - 1]);
+                data[index] = std::move(value);
+            }
+        }
+
+        // Destroys the element at index and moves the ones after it one position down
+        template <typename T>
+        void erase(T* data, uint32 size, uint32 index)
+        {
+            coda_dbg_assert(index < size);
+            if constexpr (is_trivially_relocatable<T>::value)
+            {
+                data[index].~T();
+                memmove(static_cast<void*>(&data[index]), static_cast<const void*>(&data[index + 1]), (size - index - 1) * sizeof(T));
+            }
+            else
+            {
+                for (uint32 i = index + 1; i < size; ++i)
+                    data[i - 1] = std::move(data[i]);
+                data[size - 1].~T();
+            }
+        }
+    }
+}
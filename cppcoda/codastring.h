@@ -2,20 +2,37 @@
 
 #include "common.h"
 #include "allocator.h"
+#include "hash.h"
+#include "stringview.h"
+#include "format.h"
+#include "instrumentation.h"
 #include <cstdarg>
+#include <cstdio>
 #include <cstring>
+#include <type_traits>
 
 
 namespace coda
 {
+    /**
+     * Null terminated string. Contents shorter than inlineCapacity are stored in the object itself,
+     * the heap is only used for longer ones. The last byte of the object tells the mode apart: the
+     * spare inline capacity (so it doubles as the terminator of a full inline string), or a marker
+     * for heap and null strings. A null string has no buffer at all and c_str() returns nullptr.
+     */
     template <typename AllocatorType>
-    class string_base
+    class string_base : private allocatorholder<AllocatorType>
     {
         typedef AllocatorType allocator;
+        typedef allocatorholder<AllocatorType> allocator_holder;
     public:
+        // Bytes stored inline, terminator included
+        static constexpr uint32 inlineCapacity = 24;
 
-        string_base() : m_data(nullptr), m_capacity(0) {}
-        string_base(const char* str);
+        string_base() { invalidate(); }
+        explicit string_base(const allocator& alloc) : allocator_holder(alloc) { invalidate(); }
+        string_base(const char* str, const allocator& alloc = allocator());
+        explicit string_base(stringview str, const allocator& alloc = allocator());
         string_base(const string_base& other);
         string_base(string_base&& rvl);
         ~string_base();
@@ -26,51 +43,151 @@ namespace coda
         string_base& operator=(const char* str);
 
         bool operator==(const string_base& other) const;
+        bool operator==(stringview other) const { return stringview(*this) == other; }
+        bool operator==(const char* str) const { return stringview(*this) == stringview(str); }
 
-        const char* c_str() const { return m_data; }
-        uint32 getCapacity() const { return m_capacity; }
+        operator stringview() const { return stringview(c_str(), getLength()); }
+
+        const char* c_str() const { return isHeap() ? m_storage.heap.data : isNull() ? nullptr : m_storage.buffer; }
+        uint32 getCapacity() const { return isHeap() ? m_storage.heap.capacity : isNull() ? 0 : inlineCapacity; }
         uint32 getLength() const;
-        bool isEmpty() const { return m_data ? !*m_data : true; }
+        bool isEmpty() const { return !getLength(); }
+        // Contents stored in the object
+        bool isInline() const { return getMode() < modeNull; }
 
         void set(const char* str);
+        // Copies length characters, str doesn't need to be null terminated
+        void set(const char* str, uint32 length);
         void set(const string_base& str);
+        // Appends grow the capacity geometrically, building a string takes O(log n) reallocations
+        string_base& append(const char* str, uint32 length);
+        // Integers and floating point values are written as text, also takes bool, char, C strings,
+        // views and strings
+        template <typename T>
+        string_base& append(const T& value);
+        template <typename T>
+        string_base& operator+=(const T& value) { return append(value); }
+        // Makes room for length characters
+        void reserve(uint32 length) { ensureCapacity(length + 1); }
+
+        // printf style, formats straight into the current buffer when it fits
         void setFmt(const char* fmt, ...);
+        void appendFmt(const char* fmt, ...);
+        // Replaces each {} in fmt with the next argument, {{ and }} write a brace. Takes integers,
+        // floating point values, bool, char, C strings, views and strings.
+        template <typename... Args>
+        void format(const char* fmt, const Args&... args);
         void clear(bool releaseMemory = false);
 
+        using allocator_holder::getAllocator;
+
     private:
-        static char* allocate(uint32 size);
-        static char* reallocate(char* p, uint32 size);
-        static void release(void* p);
+        enum : uint8
+        {
+            // values of the mode byte, inline strings store their spare capacity there instead
+            modeNull = 0x40,
+            modeHeap = 0x80,
+        };
+
+        uint8 getMode() const { return static_cast<uint8>(m_storage.buffer[inlineCapacity - 1]); }
+        void setMode(uint8 mode) { m_storage.buffer[inlineCapacity - 1] = static_cast<char>(mode); }
+        bool isHeap() const { return getMode() == modeHeap; }
+        bool isNull() const { return getMode() == modeNull; }
+
+        char* getData() { return isHeap() ? m_storage.heap.data : m_storage.buffer; }
+        // Makes room for size bytes, terminator included, keeping the contents
+        void ensureCapacity(uint32 size);
+        // Like ensureCapacity, growing geometrically
+        void growCapacity(uint32 size);
+        // Length of the contents just written
+        void setLength(uint32 length);
+
+        void formatAt(uint32 offset, const char* fmt, va_list va);
+        // Appends fmt up to its first {} and returns it, nullptr if there is none
+        const char* appendFormatChunk(const char* fmt);
+        void appendFormatted(const char* fmt);
+        template <typename T, typename... Args>
+        void appendFormatted(const char* fmt, const T& value, const Args&... args);
+
+        char* allocate(uint32 size);
+        char* reallocate(char* p, uint32 size);
+        void release(void* p);
 
         void invalidate();
 
     private:
-        char* m_data;
-        uint32 m_capacity;
+        union storagetype
+        {
+            struct
+            {
+                char* data;
+                uint32 capacity;
+                uint32 length;
+            } heap;
+            char buffer[inlineCapacity];
+        };
+        static_assert(sizeof(storagetype) == inlineCapacity, "inline buffer must cover the heap fields");
+
+        storagetype m_storage;
     };
 
     typedef string_base<baseallocator> string;
 
+    template <typename AllocatorType>
+    struct hasher<string_base<AllocatorType>>
+    {
+        // same value as hashing the C string
+        uint64 operator()(const string_base<AllocatorType>& str) const { return hashBytes(str.c_str(), str.getLength()); }
+    };
+
+    template <typename AllocatorType, typename T>
+    inline string_base<AllocatorType> operator+(string_base<AllocatorType> str, const T& value)
+    {
+        str.append(value);
+        return str;
+    }
+
+    // lookups by C string or view don't build a temporary string
+    template <typename AllocatorType>
+    struct is_hash_compatible<string_base<AllocatorType>, stringview> : std::true_type {};
+    template <typename AllocatorType>
+    struct is_hash_compatible<string_base<AllocatorType>, const char*> : std::true_type {};
+    template <typename AllocatorType>
+    struct is_hash_compatible<string_base<AllocatorType>, char*> : std::true_type {};
+
+    // inline contents are addressed from the object, nothing points into it
+    template <typename AllocatorType>
+    struct is_trivially_relocatable<string_base<AllocatorType>> : is_trivially_relocatable<AllocatorType> {};
+
     template<typename AllocatorType>
-    inline string_base<AllocatorType>::string_base(const char* str)
-        : m_data(nullptr), m_capacity(0)
+    inline string_base<AllocatorType>::string_base(const char* str, const allocator& alloc)
+        : allocator_holder(alloc)
     {
+        invalidate();
         set(str);
     }
 
+    template<typename AllocatorType>
+    inline string_base<AllocatorType>::string_base(stringview str, const allocator& alloc)
+        : allocator_holder(alloc)
+    {
+        invalidate();
+        set(str.getData(), str.getLength());
+    }
+
     template<typename AllocatorType>
     inline string_base<AllocatorType>::string_base(const string_base& other)
-        : m_data(nullptr), m_capacity(0)
+        : allocator_holder(other.getAllocator())
     {
+        invalidate();
         set(other);
     }
 
     template<typename AllocatorType>
     inline string_base<AllocatorType>::string_base(string_base&& rvl)
-        : m_data(nullptr), m_capacity(0)
+        : allocator_holder(rvl.getAllocator())
     {
-        m_data = rvl.m_data;
-        m_capacity = rvl.m_capacity;
+        m_storage = rvl.m_storage;
         rvl.invalidate();
     }
 
@@ -91,8 +208,9 @@ namespace coda
     inline string_base<AllocatorType>& string_base<AllocatorType>::operator=(string_base&& rvl)
     {
         clear(true);
-        m_data = rvl.m_data;
-        m_capacity = rvl.m_capacity;
+        // the buffer goes back to the allocator it came from
+        getAllocator() = rvl.getAllocator();
+        m_storage = rvl.m_storage;
         rvl.invalidate();
         return *this;
     }
@@ -107,54 +225,49 @@ namespace coda
     template<typename AllocatorType>
     inline bool string_base<AllocatorType>::operator==(const string_base& other) const
     {
-        if (!m_data && !other.m_data)
-            return true;
-        if (m_data && !other.m_data)
-        {
-            if (!*m_data) 
-                return true;
-            return false;
-        }
-        if (other.m_data && !m_data)
-        {
-            if (!*other.m_data)
-                return true;
+        // null and empty strings are equal
+        uint32 length = getLength();
+        if (length != other.getLength())
             return false;
-        }
-
-        return !strcmp(m_data, other.m_data);
+        return !length || !memcmp(c_str(), other.c_str(), length);
     }
 
     template<typename AllocatorType>
     inline uint32 string_base<AllocatorType>::getLength() const
     {
-        return m_data ? safe_cast<uint32>(strlen(m_data)) : 0;
+        if (isInline())
+            return inlineCapacity - 1 - getMode();
+        return isHeap() ? m_storage.heap.length : 0;
     }
 
     template<typename AllocatorType>
     inline void string_base<AllocatorType>::set(const char* str)
     {
-        if (!str || !*str)
+        set(str, str ? safe_cast<uint32>(strlen(str)) : 0);
+    }
+
+    template<typename AllocatorType>
+    inline void string_base<AllocatorType>::set(const char* str, uint32 length)
+    {
+        if (!length)
         {
             clear();
         }
         else
         {
-            uint32 s = safe_cast<uint32>(strlen(str)) + 1;
-            if (m_capacity < s)
-            {
-                m_data = reallocate(m_data, s);
-                m_capacity = s;
-            }
-            memcpy_s(m_data, m_capacity, str, s);
-            coda_assert(m_data[s - 1] == 0);
+            ensureCapacity(length + 1);
+            char* data = getData();
+            memcpy(data, str, length);
+            data[length] = 0;
+            setLength(length);
         }
     }
 
     template<typename AllocatorType>
     inline void string_base<AllocatorType>::set(const string_base& str)
     {
-        set(str.c_str());
+        if (this != &str)
+            set(str.c_str(), str.getLength());
     }
 
     template<typename AllocatorType>
@@ -162,56 +275,231 @@ namespace coda
     {
         va_list va;
         va_start(va, fmt);
-        uint32 s = _vscprintf(fmt, va) + 1;
-        if (s > m_capacity)
+        formatAt(0, fmt, va);
+        va_end(va);
+    }
+
+    template<typename AllocatorType>
+    inline void string_base<AllocatorType>::appendFmt(const char* fmt, ...)
+    {
+        va_list va;
+        va_start(va, fmt);
+        formatAt(getLength(), fmt, va);
+        va_end(va);
+    }
+
+    template<typename AllocatorType>
+    template<typename... Args>
+    inline void string_base<AllocatorType>::format(const char* fmt, const Args&... args)
+    {
+        clear();
+        appendFormatted(fmt, args...);
+    }
+
+    template<typename AllocatorType>
+    inline void string_base<AllocatorType>::formatAt(uint32 offset, const char* fmt, va_list va)
+    {
+        // the second pass only happens when the first one didn't fit
+        va_list vacopy;
+        va_copy(vacopy, va);
+        uint32 capacity = getCapacity();
+        // without a buffer the first pass only measures
+        int written = capacity ? vsnprintf(getData() + offset, capacity - offset, fmt, va) : vsnprintf(nullptr, 0, fmt, va);
+        coda_assert(written >= 0);
+        uint32 length = offset + static_cast<uint32>(written);
+        if (length >= capacity)
         {
-            m_data = reallocate(m_data, s);
-            m_capacity = s;
+            // the first pass may have overwritten the inline mode byte
+            if (!isNull())
+                setLength(offset);
+            growCapacity(length + 1);
+            vsnprintf(getData() + offset, getCapacity() - offset, fmt, vacopy);
         }
-        vsprintf_s(m_data, m_capacity, fmt, va);
+        va_end(vacopy);
+        setLength(length);
+    }
 
-        va_end(va);
+    template<typename AllocatorType>
+    inline string_base<AllocatorType>& string_base<AllocatorType>::append(const char* str, uint32 length)
+    {
+        uint32 offset = getLength();
+        if (offset + length + 1 > getCapacity())
+        {
+            // str may be part of this string, the contents keep their offset in the new buffer
+            uintptr_t old = reinterpret_cast<uintptr_t>(c_str());
+            uintptr_t source = reinterpret_cast<uintptr_t>(str);
+            growCapacity(offset + length + 1);
+            if (old && source >= old && source < old + offset)
+                str = getData() + (source - old);
+        }
+        char* data = getData();
+        memcpy(data + offset, str, length);
+        data[offset + length] = 0;
+        setLength(offset + length);
+        return *this;
+    }
+
+    template<typename AllocatorType>
+    template<typename T>
+    inline string_base<AllocatorType>& string_base<AllocatorType>::append(const T& value)
+    {
+        char buffer[formatValueMaxLength];
+        if constexpr (std::is_same<T, bool>::value)
+            return append(value ? "true" : "false", value ? 4 : 5);
+        else if constexpr (std::is_same<T, char>::value)
+            return append(&value, 1);
+        else if constexpr (std::is_integral<T>::value && std::is_signed<T>::value)
+            return append(buffer, formatValue(buffer, static_cast<int64>(value)));
+        else if constexpr (std::is_integral<T>::value)
+            return append(buffer, formatValue(buffer, static_cast<uint64>(value)));
+        else if constexpr (std::is_same<T, float>::value)
+            return append(buffer, formatValue(buffer, value));
+        else if constexpr (std::is_floating_point<T>::value)
+            return append(buffer, formatValue(buffer, static_cast<double>(value)));
+        else
+        {
+            stringview str(value);
+            return append(str.getData(), str.getLength());
+        }
+    }
+
+    template<typename AllocatorType>
+    inline const char* string_base<AllocatorType>::appendFormatChunk(const char* fmt)
+    {
+        const char* chunk = fmt;
+        for (const char* c = fmt; *c; ++c)
+        {
+            if ((*c == '{' || *c == '}') && c[1] == *c)
+            {
+                // escaped brace, keep the first one
+                append(chunk, static_cast<uint32>(c - chunk + 1));
+                chunk = ++c + 1;
+            }
+            else if (*c == '{' && c[1] == '}')
+            {
+                append(chunk, static_cast<uint32>(c - chunk));
+                return c;
+            }
+        }
+        append(chunk, static_cast<uint32>(strlen(chunk)));
+        return nullptr;
+    }
+
+    template<typename AllocatorType>
+    inline void string_base<AllocatorType>::appendFormatted(const char* fmt)
+    {
+        const char* placeholder = appendFormatChunk(fmt);
+        coda_assert_msg(!placeholder, "format has more {} than arguments");
+    }
+
+    template<typename AllocatorType>
+    template<typename T, typename... Args>
+    inline void string_base<AllocatorType>::appendFormatted(const char* fmt, const T& value, const Args&... args)
+    {
+        const char* placeholder = appendFormatChunk(fmt);
+        coda_assert_msg(placeholder, "format has less {} than arguments");
+        append(value);
+        appendFormatted(placeholder + 2, args...);
     }
 
     template<typename AllocatorType>
     inline void string_base<AllocatorType>::clear(bool releaseMemory)
     {
-        if (!m_data)
+        if (isNull())
             return;
 
         if (releaseMemory)
         {
-            release(m_data);
+            if (isHeap())
+                release(m_storage.heap.data);
             invalidate();
         }
         else
         {
-            *m_data = 0;
+            *getData() = 0;
+            setLength(0);
+        }
+    }
+
+    template<typename AllocatorType>
+    inline void string_base<AllocatorType>::ensureCapacity(uint32 size)
+    {
+        if (isHeap())
+        {
+            if (size > m_storage.heap.capacity)
+            {
+                coda_instrument(stringstats& stats = instrumentation::getThreadStats().string);
+                coda_instrument(stats.reallocations.add());
+                coda_instrument(stats.bytesMoved.add(m_storage.heap.length + 1));
+                m_storage.heap.data = reallocate(m_storage.heap.data, size);
+                m_storage.heap.capacity = size;
+            }
+        }
+        else if (size > inlineCapacity)
+        {
+            char* data = allocate(size);
+            uint32 length = getLength();
+            if (isNull())
+            {
+                *data = 0;
+            }
+            else
+            {
+                memcpy(data, m_storage.buffer, length + 1);
+                coda_instrument(stringstats& stats = instrumentation::getThreadStats().string);
+                coda_instrument(stats.spills.add());
+                coda_instrument(stats.bytesMoved.add(length + 1));
+            }
+            m_storage.heap.data = data;
+            m_storage.heap.capacity = size;
+            m_storage.heap.length = length;
+            setMode(modeHeap);
+        }
+        else if (isNull())
+        {
+            m_storage.buffer[0] = 0;
+            setLength(0);
         }
     }
 
+    template<typename AllocatorType>
+    inline void string_base<AllocatorType>::growCapacity(uint32 size)
+    {
+        uint32 capacity = getCapacity();
+        if (size > capacity)
+            ensureCapacity(size > capacity * 2 ? size : capacity * 2);
+    }
+
+    template<typename AllocatorType>
+    inline void string_base<AllocatorType>::setLength(uint32 length)
+    {
+        if (isHeap())
+            m_storage.heap.length = length;
+        else
+            setMode(static_cast<uint8>(inlineCapacity - 1 - length));
+    }
+
     template<typename AllocatorType>
     inline char* string_base<AllocatorType>::allocate(uint32 size)
     {
-        return (char*)allocator::allocate(size);
+        return (char*)getAllocator().allocate(size);
     }
 
     template<typename AllocatorType>
     inline char* string_base<AllocatorType>::reallocate(char* p, uint32 size)
     {
-        return (char*)allocator::reallocate(p, size);
+        return (char*)getAllocator().reallocate(p, size);
     }
 
     template<typename AllocatorType>
     inline void string_base<AllocatorType>::release(void* p)
     {
-        allocator::release(p);
+        getAllocator().release(p);
     }
 
     template<typename AllocatorType>
     inline void string_base<AllocatorType>::invalidate()
     {
-        m_data = nullptr;
-        m_capacity = 0;
+        setMode(modeNull);
     }
-}
+}
\ No newline at end of file
@@ -4,10 +4,38 @@
 
 #define coda_dummy_macro ((void)0)
 
-#define coda_assert(x) ((x) ? coda_dummy_macro : coda::throwException("Assertion failed: "#x, __FILE__, __LINE__))
-#define coda_assert_msg(x, msg) ((x) ? coda_dummy_macro : coda::throwException("Assertion failed: " msg, __FILE__, __LINE__))
+#if defined(__GNUC__) || defined(__clang__)
+#define coda_likely(x) __builtin_expect(!!(x), 1)
+#define coda_unlikely(x) __builtin_expect(!!(x), 0)
+#define CODA_NOINLINE __attribute__((noinline))
+#define CODA_COLD __attribute__((cold))
+#elif defined(_MSC_VER)
+#define coda_likely(x) (x)
+#define coda_unlikely(x) (x)
+#define CODA_NOINLINE __declspec(noinline)
+#define CODA_COLD
+#else
+#define coda_likely(x) (x)
+#define coda_unlikely(x) (x)
+#define CODA_NOINLINE
+#define CODA_COLD
+#endif
 
+// Check levels: 0 keeps coda_assert only, 1 adds coda_dbg_assert and 2 adds coda_paranoid_assert,
+// meant for internal invariants and the unchecked accessors.
+#ifndef CODA_CHECK_LEVEL
 #ifdef _DEBUG
+#define CODA_CHECK_LEVEL 1
+#else
+#define CODA_CHECK_LEVEL 0
+#endif
+#endif
+
+// Always on. The failure path is cold and out of line so the check costs a predicted branch.
+#define coda_assert(x) (coda_likely(x) ? coda_dummy_macro : coda::throwException("Assertion failed: "#x, __FILE__, __LINE__))
+#define coda_assert_msg(x, msg) (coda_likely(x) ? coda_dummy_macro : coda::throwException("Assertion failed: " msg, __FILE__, __LINE__))
+
+#if CODA_CHECK_LEVEL >= 1
 #define coda_dbg_assert(x) coda_assert(x)
 #define coda_dbg_assert_msg(x, msg) coda_assert_msg(x,msg)
 #else
@@ -15,13 +43,26 @@
 #define coda_dbg_assert_msg(x, msg) coda_dummy_macro
 #endif
 
+#if CODA_CHECK_LEVEL >= 2
+#define coda_paranoid_assert(x) coda_assert(x)
+#define coda_paranoid_assert_msg(x, msg) coda_assert_msg(x,msg)
+#else
+#define coda_paranoid_assert(x) coda_dummy_macro
+#define coda_paranoid_assert_msg(x, msg) coda_dummy_macro
+#endif
+
 
 #ifdef CODA_USE_STD
 #include <limits>
+#include <cstddef>
 #else
 #error Currently not supported without some stdlib functionalities
 #endif
 
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
 
 namespace coda
 {
@@ -47,11 +88,34 @@ namespace coda
     // Global index type
     using index_t = size_t;
 
+    // Bit scan helpers, value must not be zero
+    inline uint32 bitScanForward(uint64 value)
+    {
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanForward64(&index, value);
+        return index;
+#else
+        return static_cast<uint32>(__builtin_ctzll(value));
+#endif
+    }
+
+    inline uint32 bitScanReverse(uint64 value)
+    {
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanReverse64(&index, value);
+        return index;
+#else
+        return static_cast<uint32>(63 - __builtin_clzll(value));
+#endif
+    }
+
     // Exception handling
     typedef void (*ExceptionHandler)(const char* message, const char* file, int line);
     void setExceptionHandler(ExceptionHandler handler);
-    void dumpException(const char* message, const char* file, int line);
-    void throwException(const char* message, const char* file, int line);
+    CODA_COLD void dumpException(const char* message, const char* file, int line);
+    CODA_COLD CODA_NOINLINE void throwException(const char* message, const char* file, int line);
 
     // Cast functions with limit checking
     template <typename T, typename U>
@@ -0,0 +1,169 @@
+#pragma once
+
+#include "common.h"
+#include "hashtable.h"
+#include <mutex>
+#include <shared_mutex>
+
+namespace coda
+{
+    /**
+     * Hashtable safe to use from several threads at once.
+     * Items are spread over a power of two number of shards by the high bits of their hash, each one a
+     * coda::hashtable behind its own reader-writer lock. Lookups take the shard lock shared, so readers
+     * only contend with writers of the same shard, and inserts/erases only block their own shard.
+     * Items are copied out or visited under the lock since another thread may destroy them at any time.
+     */
+    template <typename KeyType, typename ItemType, typename AllocatorType = coda::baseallocator, typename size_type = uint32>
+    class concurrenthashtable : private allocatorholder<AllocatorType>
+    {
+        typedef hashtable<KeyType, ItemType, AllocatorType, size_type> tabletype;
+        typedef allocatorholder<AllocatorType> allocator_holder;
+
+        // one cache line per shard so writers of a shard don't slow down readers of the next one
+        struct alignas(64) shardtype
+        {
+            shardtype(size_type size, const AllocatorType& allocator) : table(size, tabletype::defaultMaxLoadFactor, allocator) {}
+
+            mutable std::shared_mutex lock;
+            tabletype table;
+        };
+    public:
+        static constexpr uint32 defaultShardCount = 64;
+
+        // size is the total initial capacity, shards grow independently
+        concurrenthashtable(size_type _size = 1024, uint32 _shardCount = defaultShardCount, const AllocatorType& allocator = AllocatorType());
+        ~concurrenthashtable();
+
+        concurrenthashtable(const concurrenthashtable&) = delete;
+        concurrenthashtable& operator=(const concurrenthashtable&) = delete;
+
+        // Returns false and leaves the table untouched if the key is already in it.
+        bool createItem(const KeyType& key, const ItemType& item);
+        // Copies the item into outItem.
+        bool findItem(const KeyType& key, ItemType& outItem) const;
+        bool contains(const KeyType& key) const;
+        bool destroyItem(const KeyType& key);
+
+        // Calls function(const ItemType&) under the shard read lock.
+        template <typename Function>
+        bool visitItem(const KeyType& key, Function function) const;
+        // Calls function(ItemType&) under the shard write lock.
+        template <typename Function>
+        bool updateItem(const KeyType& key, Function function);
+
+        // Sum of the shard counts, only exact while no other thread writes.
+        size_type getCount() const;
+        uint32 getShardCount() const { return shardCount; }
+
+        using allocator_holder::getAllocator;
+
+    private:
+        shardtype& getShard(uint64 hash) const { return shards[shardCount > 1 ? hash >> shardShift : 0]; }
+
+    private:
+        shardtype* shards;
+        uint32 shardCount;
+        uint32 shardShift;
+    };
+
+    template<typename KeyType, typename ItemType, typename AllocatorType, typename size_type>
+    inline concurrenthashtable<KeyType, ItemType, AllocatorType, size_type>::concurrenthashtable(size_type _size, uint32 _shardCount, const AllocatorType& allocator)
+        : allocator_holder(allocator), shards(nullptr), shardCount(_shardCount), shardShift(0)
+    {
+        coda_assert_msg(shardCount && !(shardCount & (shardCount - 1)), "shard count must be a power of two");
+        // shards are picked with the top bits, the hashtable uses the low ones
+        shardShift = 64 - bitScanForward(shardCount);
+
+        shards = static_cast<shardtype*>(allocateAligned(getAllocator(), sizeof(shardtype) * shardCount, alignof(shardtype)));
+        coda_assert(shards);
+
+        size_type shardSize = _size / shardCount;
+        for (uint32 i = 0; i < shardCount; ++i)
+            new (&shards[i]) shardtype(shardSize ? shardSize : 1, allocator);
+    }
+
+    template<typename KeyType, typename ItemType, typename AllocatorType, typename size_type>
+    inline concurrenthashtable<KeyType, ItemType, AllocatorType, size_type>::~concurrenthashtable()
+    {
+        for (uint32 i = 0; i < shardCount; ++i)
+            shards[i].~shardtype();
+        releaseAligned(getAllocator(), shards, alignof(shardtype));
+    }
+
+    template<typename KeyType, typename ItemType, typename AllocatorType, typename size_type>
+    inline bool concurrenthashtable<KeyType, ItemType, AllocatorType, size_type>::createItem(const KeyType& key, const ItemType& item)
+    {
+        uint64 hash = tabletype::getHash(key);
+        shardtype& shard = getShard(hash);
+        std::unique_lock<std::shared_mutex> lock(shard.lock);
+        size_type slot;
+        if (shard.table.findEntry(key, hash, slot) != tabletype::invalidIndex)
+            return false;
+        shard.table.createItem(key, item, hash);
+        return true;
+    }
+
+    template<typename KeyType, typename ItemType, typename AllocatorType, typename size_type>
+    inline bool concurrenthashtable<KeyType, ItemType, AllocatorType, size_type>::findItem(const KeyType& key, ItemType& outItem) const
+    {
+        return visitItem(key, [&outItem](const ItemType& item) { outItem = item; });
+    }
+
+    template<typename KeyType, typename ItemType, typename AllocatorType, typename size_type>
+    inline bool concurrenthashtable<KeyType, ItemType, AllocatorType, size_type>::contains(const KeyType& key) const
+    {
+        return visitItem(key, [](const ItemType&) {});
+    }
+
+    template<typename KeyType, typename ItemType, typename AllocatorType, typename size_type>
+    inline bool concurrenthashtable<KeyType, ItemType, AllocatorType, size_type>::destroyItem(const KeyType& key)
+    {
+        uint64 hash = tabletype::getHash(key);
+        shardtype& shard = getShard(hash);
+        std::unique_lock<std::shared_mutex> lock(shard.lock);
+        return shard.table.destroyItem(key, hash);
+    }
+
+    template<typename KeyType, typename ItemType, typename AllocatorType, typename size_type>
+    template<typename Function>
+    inline bool concurrenthashtable<KeyType, ItemType, AllocatorType, size_type>::visitItem(const KeyType& key, Function function) const
+    {
+        uint64 hash = tabletype::getHash(key);
+        const shardtype& shard = getShard(hash);
+        std::shared_lock<std::shared_mutex> lock(shard.lock);
+        size_type slot;
+        size_type entry = shard.table.findEntry(key, hash, slot);
+        if (entry == tabletype::invalidIndex)
+            return false;
+        function(static_cast<const ItemType&>(shard.table.getItem(entry)));
+        return true;
+    }
+
+    template<typename KeyType, typename ItemType, typename AllocatorType, typename size_type>
+    template<typename Function>
+    inline bool concurrenthashtable<KeyType, ItemType, AllocatorType, size_type>::updateItem(const KeyType& key, Function function)
+    {
+        uint64 hash = tabletype::getHash(key);
+        shardtype& shard = getShard(hash);
+        std::unique_lock<std::shared_mutex> lock(shard.lock);
+        size_type slot;
+        size_type entry = shard.table.findEntry(key, hash, slot);
+        if (entry == tabletype::invalidIndex)
+            return false;
+        function(shard.table.getItem(entry));
+        return true;
+    }
+
+    template<typename KeyType, typename ItemType, typename AllocatorType, typename size_type>
+    inline size_type concurrenthashtable<KeyType, ItemType, AllocatorType, size_type>::getCount() const
+    {
+        size_type total = 0;
+        for (uint32 i = 0; i < shardCount; ++i)
+        {
+            std::shared_lock<std::shared_mutex> lock(shards[i].lock);
+            total += shards[i].table.getCount();
+        }
+        return total;
+    }
+}
@@ -0,0 +1,50 @@
+#include "cpu.h"
+
+#if defined(CODA_X86_64) && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace coda
+{
+    static cpufeatures detectCpuFeatures()
+    {
+        cpufeatures features;
+#if defined(CODA_X86_64)
+        // SSE2 is part of the x86-64 baseline
+        features.sse2 = true;
+#if defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0] >= 7)
+        {
+            __cpuid(info, 1);
+            bool osxsave = (info[2] & (1 << 27)) != 0;
+            bool avx = (info[2] & (1 << 28)) != 0;
+            // the OS must save the ymm registers
+            bool ymmEnabled = osxsave && (_xgetbv(0) & 0x6) == 0x6;
+            __cpuidex(info, 7, 0);
+            features.avx2 = avx && ymmEnabled && (info[1] & (1 << 5)) != 0;
+        }
+#else
+        __builtin_cpu_init();
+        features.avx2 = __builtin_cpu_supports("avx2") != 0;
+#endif
+#endif
+        return features;
+    }
+
+    static const cpufeatures& getDetectedCpuFeatures()
+    {
+        static const cpufeatures detected = detectCpuFeatures();
+        return detected;
+    }
+
+    cpufeatures currentCpuFeatures = getDetectedCpuFeatures();
+
+    void setCpuFeatures(const cpufeatures& features)
+    {
+        const cpufeatures& detected = getDetectedCpuFeatures();
+        currentCpuFeatures.sse2 = features.sse2 && detected.sse2;
+        currentCpuFeatures.avx2 = features.avx2 && detected.avx2;
+    }
+}
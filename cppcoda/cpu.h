@@ -0,0 +1,34 @@
+#pragma once
+
+#include "common.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define CODA_X86_64
+#include <immintrin.h>
+#endif
+
+// Functions using instructions above the compile target must be tagged so GCC/Clang accept the intrinsics.
+// MSVC allows any intrinsic anywhere.
+#if defined(CODA_X86_64) && !defined(_MSC_VER)
+#define CODA_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define CODA_TARGET_AVX2
+#endif
+
+namespace coda
+{
+    // Instruction sets available at runtime
+    struct cpufeatures
+    {
+        bool sse2 = false;
+        bool avx2 = false;
+    };
+
+    // Detected before main, no features (the scalar paths) until then. Read inline, hashtable
+    // lookups check it on every probe.
+    extern cpufeatures currentCpuFeatures;
+
+    inline const cpufeatures& getCpuFeatures() { return currentCpuFeatures; }
+    // Overrides the detected features, used to force fallback paths. Features the CPU lacks are ignored.
+    void setCpuFeatures(const cpufeatures& features);
+}
@@ -2,27 +2,79 @@
 
 #include "common.h"
 #include "allocator.h"
+#include "arrayops.h"
+#include "instrumentation.h"
+#include "span.h"
 #include <cmath>
+#include <utility>
 
 namespace coda
 {
     template <typename T, typename AllocatorType = coda::baseallocator>
-    class dynarray
+    class dynarray : private allocatorholder<AllocatorType>
     {
-        typedef dynarray<T> self_type;
+        typedef dynarray<T, AllocatorType> self_type;
+        typedef allocatorholder<AllocatorType> allocator_holder;
+    public:
         typedef T value_type;
         typedef uint32 size_type;
         typedef AllocatorType allocator_type;
-    public:
+        typedef T* iterator;
+        typedef const T* const_iterator;
+
         static constexpr float defaultIncrementFactor = 1.5f;
+        // First capacity allocated when growing an empty array
+        static constexpr size_type minGrowCapacity = 4;
+        // Alignment of the elements storage, see CODA_STORAGE_ALIGNMENT
+        static constexpr size_t storageAlignment = storage_alignment<value_type>::value;
 
-        dynarray() : m_data(nullptr), m_size(0), m_capacity(0), m_incrementFactor(defaultIncrementFactor) {}
-        dynarray(size_type capacity) : m_data(nullptr), m_size(0), m_capacity(0), m_incrementFactor(defaultIncrementFactor)
+        dynarray(const allocator_type& allocator = allocator_type())
+            : allocator_holder(allocator), m_data(nullptr), m_size(0), m_capacity(0), m_incrementFactor(defaultIncrementFactor) {}
+        dynarray(size_type capacity, const allocator_type& allocator = allocator_type())
+            : allocator_holder(allocator), m_data(nullptr), m_size(0), m_capacity(0), m_incrementFactor(defaultIncrementFactor)
         {
             reserve(capacity);
         }
+        dynarray(const self_type& other)
+            : allocator_holder(other.getAllocator()), m_data(nullptr), m_size(0), m_capacity(0), m_incrementFactor(other.m_incrementFactor)
+        {
+            copyFrom(other);
+        }
+        dynarray(self_type&& other)
+            : allocator_holder(other.getAllocator()), m_data(other.m_data), m_size(other.m_size), m_capacity(other.m_capacity), m_incrementFactor(other.m_incrementFactor)
+        {
+            other.m_data = nullptr;
+            other.m_size = 0;
+            other.m_capacity = 0;
+        }
         ~dynarray() { clear(true); }
 
+        self_type& operator=(const self_type& other)
+        {
+            if (this != &other)
+            {
+                clear();
+                copyFrom(other);
+            }
+            return *this;
+        }
+
+        self_type& operator=(self_type&& other)
+        {
+            if (this != &other)
+            {
+                clear(true);
+                getAllocator() = other.getAllocator();
+                m_data = other.m_data;
+                m_size = other.m_size;
+                m_capacity = other.m_capacity;
+                other.m_data = nullptr;
+                other.m_size = 0;
+                other.m_capacity = 0;
+            }
+            return *this;
+        }
+
         void setIncrementFactor(float factor = defaultIncrementFactor) { m_incrementFactor = factor; }
 
         void reserve(size_type newCapacity)
@@ -43,25 +95,23 @@ namespace coda
                 // destruct the elements between current size and new capacity
                 if (m_size >= newCapacity)
                 {
-                    for (size_type i = newCapacity; i < m_size; ++i)
-                        destroyItem(i);
+                    arrayops::destroy(m_data, newCapacity, m_size);
                     m_size = newCapacity;
                     shrink();
                 }
                 else
                 {
-                    m_data = reallocate(m_data, newCapacity);
-                    m_capacity = newCapacity;
+                    relocate(newCapacity);
                 }
             }
             else
             {
                 // capacity is greater than currently allocated
-                m_data = reallocate(m_data, newCapacity);
-                m_capacity = newCapacity;
+                relocate(newCapacity);
             }
         }
 
+        // New elements are value initialized
         void resize(size_type newSize)
         {
             if (newSize == m_size)
@@ -71,59 +121,90 @@ namespace coda
             {
                 if (newSize > m_capacity)
                     reserve(newSize);
+                arrayops::construct(m_data, m_size, newSize);
                 m_size = newSize;
             }
             else
             {
-                for (uint32 i = newSize; i < m_size; ++i)
-                    destroyItem(i);
+                arrayops::destroy(m_data, newSize, m_size);
                 m_size = newSize;
                 shrink();
             }
         }
 
+        // Vector stores or memset for trivially copyable types, see simd::fill
         void fill(const value_type& value, size_type first, size_type count)
         {
-            size_type end = first + count;
-            coda_assert(end <= m_size);
-            for (size_type i = first; i < end; ++i)
-                constructItem(i, value);
+            coda_assert(first + count <= m_size);
+            arrayops::fill(m_data + first, count, value);
         }
 
         void shrink()
         {
             if (!m_capacity || m_size == m_capacity)
                 return;
-            value_type* newData = reallocate(m_data, m_size);
-            m_data = newData;
-            m_capacity = m_size;
+            relocate(m_size);
         }
 
         void clear(bool releaseMemory = false)
         {
-            for (size_type i = 0; i < m_size; ++i)
-                destroyItem(i);
+            arrayops::destroy(m_data, 0, m_size);
             m_size = 0;
             if (releaseMemory)
                 shrink();
         }
 
-        value_type& pushBack(const value_type& value)
+        value_type& pushBack(const value_type& value) { return emplaceBack(value); }
+        value_type& pushBack(value_type&& value) { return emplaceBack(std::move(value)); }
+        value_type& pushBack() { return emplaceBack(); }
+
+        // Constructs the element in place from args
+        template <typename... Args>
+        value_type& emplaceBack(Args&&... args)
         {
-            coda_assert(m_size <= m_capacity && m_incrementFactor > 1.f);
-            if (m_size == m_capacity)
+            if (m_size < m_capacity)
             {
-                size_type newCapacity = static_cast<size_type>(ceilf((float)m_capacity * m_incrementFactor));
-                coda_assert(newCapacity > m_capacity);
-                resize(newCapacity);
+                arrayops::construct(m_data + m_size, std::forward<Args>(args)...);
+                return m_data[m_size++];
             }
-            constructItem(m_size++, value);
-            return m_data[m_size-1];
+            // args may refer to an element, build the value before the storage moves
+            value_type value(std::forward<Args>(args)...);
+            grow();
+            arrayops::construct(m_data + m_size, std::move(value));
+            return m_data[m_size++];
+        }
+
+        // Moves the elements from index on one position up, index may be the size
+        value_type& insert(size_type index, const value_type& value) { return emplace(index, value); }
+        value_type& insert(size_type index, value_type&& value) { return emplace(index, std::move(value)); }
+
+        template <typename... Args>
+        value_type& emplace(size_type index, Args&&... args)
+        {
+            coda_assert(index <= m_size);
+            if (index == m_size)
+                return emplaceBack(std::forward<Args>(args)...);
+
+            value_type value(std::forward<Args>(args)...);
+            if (m_size == m_capacity)
+                grow();
+            arrayops::insert(m_data, m_size, index, std::move(value));
+            ++m_size;
+            return m_data[index];
         }
 
-        value_type& pushBack()
+        // Moves the elements after index one position down
+        void erase(size_type index)
         {
-            return pushBack(value_type());
+            coda_assert(index < m_size);
+            arrayops::erase(m_data, m_size, index);
+            --m_size;
+        }
+
+        void popBack()
+        {
+            coda_assert(m_size > 0);
+            arrayops::destroy(m_data + --m_size);
         }
 
         bool isEmpty() const { return m_size == 0; }
@@ -131,57 +212,113 @@ namespace coda
         size_type getCapacity() const { return m_capacity; }
         value_type* getData() { return m_data; }
         const value_type* getData() const { return m_data; }
-        bool isValidIndex(size_type index) { return index < m_size; }
+        bool isValidIndex(size_type index) const { return index < m_size; }
+        using allocator_holder::getAllocator;
+
+#if CODA_INSTRUMENTATION
+        const arraystats& getStats() const { return m_stats; }
+#else
+        // Never updated
+        const arraystats& getStats() const { static const arraystats empty; return empty; }
+#endif
 
         value_type& operator[](size_type index)
         {
             coda_assert(index < m_size);
-            return &m_data[index];
+            return m_data[index];
         }
 
         const value_type& operator[](size_type index) const
         {
             coda_assert(index < m_size);
-            return &m_data[index];
+            return m_data[index];
+        }
+
+        // No bounds check below CODA_CHECK_LEVEL 2, for hot loops
+        value_type& at_unchecked(size_type index)
+        {
+            coda_paranoid_assert(index < m_size);
+            return m_data[index];
+        }
+
+        const value_type& at_unchecked(size_type index) const
+        {
+            coda_paranoid_assert(index < m_size);
+            return m_data[index];
         }
 
+        iterator begin() { return m_data; }
+        iterator end() { return m_data + m_size; }
+        const_iterator begin() const { return m_data; }
+        const_iterator end() const { return m_data + m_size; }
+
+        span<value_type> getSpan() { return span<value_type>(m_data, m_size); }
+        span<const value_type> getSpan() const { return span<const value_type>(m_data, m_size); }
+
     private:
+        void grow()
+        {
+            coda_assert(m_incrementFactor > 1.f);
+            size_type newCapacity = m_capacity ? static_cast<size_type>(ceilf((float)m_capacity * m_incrementFactor)) : minGrowCapacity;
+            coda_dbg_assert(newCapacity > m_capacity);
+            coda_instrument(recordArrayStats(m_stats, [](arraystats& s) { s.regrowths.add(); }));
+            relocate(newCapacity);
+        }
 
-        void constructItem(size_type index, const value_type& value)
+        // Moves the elements to storage for newCapacity elements, which must hold all of them
+        void relocate(size_type newCapacity)
         {
-            new(&m_data[index])value_type(value);
+            coda_dbg_assert(newCapacity >= m_size);
+            CODA_TRACE_ZONE("dynarray::relocate");
+            coda_instrument(recordArrayStats(m_stats, [this](arraystats& s) { s.recordRelocation(static_cast<uint64>(m_size) * sizeof(value_type)); }));
+            if constexpr (is_trivially_relocatable<value_type>::value)
+            {
+                m_data = reallocate(m_data, newCapacity);
+            }
+            else
+            {
+                value_type* newData = newCapacity ? allocate(newCapacity) : nullptr;
+                arrayops::relocate(m_data, newData, m_size);
+                if (m_data)
+                    release(m_data);
+                m_data = newData;
+            }
+            m_capacity = newCapacity;
         }
 
-        void destroyItem(size_type index)
+        void copyFrom(const self_type& other)
         {
-            m_data[index].~value_type();
+            if (other.m_size > m_capacity)
+                reserve(other.m_size);
+            arrayops::copy(m_data, other.m_data, other.m_size);
+            m_size = other.m_size;
         }
 
-        static value_type* allocate(size_type count)
+        value_type* allocate(size_type count)
         {
-            value_type* data = (value_type*)allocator_type::allocate(count * sizeof(value_type));
+            value_type* data = (value_type*)allocateAligned(getAllocator(), count * sizeof(value_type), storageAlignment);
             coda_assert(data != nullptr);
             return data;
         }
 
-        static value_type* reallocate(value_type* data, size_type count)
+        value_type* reallocate(value_type* data, size_type count)
         {
             if (data == nullptr)
-                return (value_type*)allocator_type::allocate(count * sizeof(value_type));
+                return (value_type*)allocateAligned(getAllocator(), count * sizeof(value_type), storageAlignment);
             if (count == 0)
             {
-                allocator_type::release(data);
+                release(data);
                 return nullptr;
             }
-            value_type* newData = (value_type*)allocator_type::reallocate(data, count * sizeof(value_type));
+            value_type* newData = (value_type*)reallocateAligned(getAllocator(), data, m_capacity * sizeof(value_type), count * sizeof(value_type), storageAlignment);
             coda_assert(newData != nullptr);
             return newData;
         }
 
-        static void release(value_type* data)
+        void release(value_type* data)
         {
-            coda_assert(data != nullptr);
-            allocator_type::release(data);
+            coda_dbg_assert(data != nullptr);
+            releaseAligned(getAllocator(), data, storageAlignment);
         }
 
     private:
@@ -189,5 +326,11 @@ namespace coda
         size_type m_size;
         size_type m_capacity;
         float m_incrementFactor;
+#if CODA_INSTRUMENTATION
+        arraystats m_stats;
+#endif
     };
-}
\ No newline at end of file
+
+    template <typename T, typename AllocatorType>
+    struct is_trivially_relocatable<dynarray<T, AllocatorType>> : is_trivially_relocatable<AllocatorType> {};
+}
@@ -1,6 +1,7 @@
 #include "common.h"
 
 #include <cassert>
+#include <cstdio>
 
 namespace coda
 {
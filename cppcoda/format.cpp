@@ -0,0 +1,47 @@
+#include "format.h"
+#include <charconv>
+#include <cstdio>
+
+namespace coda
+{
+    template <typename T>
+    static inline uint32 toChars(char* buffer, T value)
+    {
+        std::to_chars_result result = std::to_chars(buffer, buffer + formatValueMaxLength, value);
+        coda_assert(result.ec == std::errc());
+        return static_cast<uint32>(result.ptr - buffer);
+    }
+
+    uint32 formatValue(char* buffer, int64 value)
+    {
+        return toChars(buffer, value);
+    }
+
+    uint32 formatValue(char* buffer, uint64 value)
+    {
+        return toChars(buffer, value);
+    }
+
+#if defined(__cpp_lib_to_chars) || defined(_MSC_VER) || (defined(__GLIBCXX__) && __GNUC__ >= 11)
+    uint32 formatValue(char* buffer, double value)
+    {
+        return toChars(buffer, value);
+    }
+
+    uint32 formatValue(char* buffer, float value)
+    {
+        return toChars(buffer, value);
+    }
+#else
+    // standard libraries without floating point to_chars
+    uint32 formatValue(char* buffer, double value)
+    {
+        return static_cast<uint32>(snprintf(buffer, formatValueMaxLength, "%.17g", value));
+    }
+
+    uint32 formatValue(char* buffer, float value)
+    {
+        return static_cast<uint32>(snprintf(buffer, formatValueMaxLength, "%.9g", value));
+    }
+#endif
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include "common.h"
+
+namespace coda
+{
+    // Room the formatValue functions may need, the longest double is 24 characters
+    static constexpr uint32 formatValueMaxLength = 32;
+
+    // Write the text of value to buffer, without terminator, and return its length. Floating
+    // point values use the shortest text that reads back to the same value.
+    uint32 formatValue(char* buffer, int64 value);
+    uint32 formatValue(char* buffer, uint64 value);
+    uint32 formatValue(char* buffer, double value);
+    uint32 formatValue(char* buffer, float value);
+}
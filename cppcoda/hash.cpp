@@ -0,0 +1,90 @@
+#include "hash.h"
+
+namespace coda
+{
+    static constexpr uint64 g_hashSecret[4] = { 0xa0761d6478bd642full, 0xe7037ed1a0b428dbull, 0x8ebc6af09c88c6e3ull, 0x589965cc75374cc3ull };
+
+    static inline uint64 read64(const uint8* p)
+    {
+        uint64 v;
+        memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    static inline uint64 read32(const uint8* p)
+    {
+        uint32 v;
+        memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    static inline void multiply(uint64& a, uint64& b)
+    {
+#if defined(__SIZEOF_INT128__)
+        __uint128_t r = static_cast<__uint128_t>(a) * b;
+        a = static_cast<uint64>(r);
+        b = static_cast<uint64>(r >> 64);
+#else
+        uint64 mixed = hashMultiplyMix(a, b);
+        uint64 low = a * b;
+        a = low;
+        b = mixed ^ low;
+#endif
+    }
+
+    uint64 hashBytes(const void* data, size_t length, uint64 seed)
+    {
+        const uint8* p = static_cast<const uint8*>(data);
+        seed ^= hashMultiplyMix(seed ^ g_hashSecret[0], g_hashSecret[1]);
+        uint64 a, b;
+        if (length <= 16)
+        {
+            if (length >= 4)
+            {
+                // two overlapping reads cover 4 to 16 bytes
+                const size_t shift = (length >> 3) << 2;
+                a = (read32(p) << 32) | read32(p + shift);
+                b = (read32(p + length - 4) << 32) | read32(p + length - 4 - shift);
+            }
+            else if (length > 0)
+            {
+                a = (static_cast<uint64>(p[0]) << 16) | (static_cast<uint64>(p[length >> 1]) << 8) | p[length - 1];
+                b = 0;
+            }
+            else
+            {
+                a = b = 0;
+            }
+        }
+        else
+        {
+            size_t i = length;
+            if (i > 48)
+            {
+                // three independent lanes keep the multipliers busy
+                uint64 see1 = seed, see2 = seed;
+                do
+                {
+                    seed = hashMultiplyMix(read64(p) ^ g_hashSecret[1], read64(p + 8) ^ seed);
+                    see1 = hashMultiplyMix(read64(p + 16) ^ g_hashSecret[2], read64(p + 24) ^ see1);
+                    see2 = hashMultiplyMix(read64(p + 32) ^ g_hashSecret[3], read64(p + 40) ^ see2);
+                    p += 48;
+                    i -= 48;
+                } while (i > 48);
+                seed ^= see1 ^ see2;
+            }
+            while (i > 16)
+            {
+                seed = hashMultiplyMix(read64(p) ^ g_hashSecret[1], read64(p + 8) ^ seed);
+                i -= 16;
+                p += 16;
+            }
+            a = read64(p + i - 16);
+            b = read64(p + i - 8);
+        }
+        a ^= g_hashSecret[1];
+        b ^= seed;
+        multiply(a, b);
+        return hashMultiplyMix(a ^ g_hashSecret[0] ^ length, b ^ g_hashSecret[1]);
+    }
+}
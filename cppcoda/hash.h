@@ -0,0 +1,110 @@
+#pragma once
+
+#include "common.h"
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <type_traits>
+
+namespace coda
+{
+    // Hash of a block of memory, reads 8 bytes at a time (wyhash).
+    uint64 hashBytes(const void* data, size_t length, uint64 seed = 0);
+
+    // 64x64->128 bit multiply folded back to 64 bits
+    inline uint64 hashMultiplyMix(uint64 a, uint64 b)
+    {
+#if defined(__SIZEOF_INT128__)
+        __uint128_t r = static_cast<__uint128_t>(a) * b;
+        return static_cast<uint64>(r) ^ static_cast<uint64>(r >> 64);
+#elif defined(_MSC_VER) && defined(_M_X64)
+        uint64 high;
+        uint64 low = _umul128(a, b, &high);
+        return low ^ high;
+#else
+        uint64 ha = a >> 32, hb = b >> 32, la = static_cast<uint32>(a), lb = static_cast<uint32>(b);
+        uint64 rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+        uint64 t = rl + (rm0 << 32);
+        uint64 carry = t < rl;
+        uint64 low = t + (rm1 << 32);
+        carry += low < t;
+        uint64 high = rh + (rm0 >> 32) + (rm1 >> 32) + carry;
+        return low ^ high;
+#endif
+    }
+
+    // Every bit of the value affects every bit of the result, integers need it since the hashtable
+    // takes its bucket index and control byte from different bits.
+    inline uint64 hashInteger(uint64 value)
+    {
+        return hashMultiplyMix(value ^ 0xa0761d6478bd642full, 0xe7037ed1a0b428dbull);
+    }
+
+    inline uint64 hashCombine(uint64 seed, uint64 value)
+    {
+        return hashMultiplyMix(seed ^ 0x8ebc6af09c88c6e3ull, value ^ 0x589965cc75374cc3ull);
+    }
+
+    /**
+     * Hash trait used by the containers, specialize it for custom key types.
+     * The result must be well distributed in all its bits.
+     */
+    template <typename T, typename Enable = void>
+    struct hasher
+    {
+        // types without a specialization go through std::hash, which may be the identity
+        uint64 operator()(const T& value) const { return hashInteger(static_cast<uint64>(std::hash<T>()(value))); }
+    };
+
+    template <typename T>
+    struct hasher<T, typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value>::type>
+    {
+        uint64 operator()(T value) const { return hashInteger(static_cast<uint64>(value)); }
+    };
+
+    template <typename T>
+    struct hasher<T, typename std::enable_if<std::is_floating_point<T>::value>::type>
+    {
+        uint64 operator()(T value) const
+        {
+            // 0.0 and -0.0 compare equal
+            if (value == T(0))
+                return hashInteger(0);
+            uint64 bits = 0;
+            memcpy(&bits, &value, sizeof(T));
+            return hashInteger(bits);
+        }
+    };
+
+    template <typename T>
+    struct hasher<T*>
+    {
+        uint64 operator()(const T* value) const { return hashInteger(reinterpret_cast<uintptr_t>(value)); }
+    };
+
+    // C strings hash their contents
+    template <>
+    struct hasher<const char*>
+    {
+        uint64 operator()(const char* value) const { return hashBytes(value, value ? strlen(value) : 0); }
+    };
+
+    template <>
+    struct hasher<char*> : hasher<const char*> {};
+
+    template <size_t N>
+    struct hasher<char[N]> : hasher<const char*> {};
+
+    /**
+     * Marks LookupType as hashing and comparing equal to KeyType for the same contents, so containers
+     * keyed by KeyType can be searched with a LookupType without converting it first.
+     */
+    template <typename KeyType, typename LookupType>
+    struct is_hash_compatible : std::is_same<KeyType, LookupType> {};
+
+    template <typename T>
+    uint64 hash_function(const T& k)
+    {
+        return hasher<T>()(k);
+    }
+}
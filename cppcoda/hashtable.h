@@ -2,277 +2,951 @@
 
 #include "common.h"
 #include "allocator.h"
-#include <xhash>
+#include "cpu.h"
+#include "hash.h"
+#include "instrumentation.h"
+#include <cstring>
+#include <iterator>
+#include <new>
+#include <type_traits>
 
 namespace coda
 {
-    template <typename T>
-    uint64 hash_function(const T& k)
-    {
-        return std::hash<T>()(k);
-    }
-
     enum { hashtable_invalidId = 0x7fffffff };
     union hashtableitemid
     {
         struct
         {
+            // Index slot the item was found in. Informative only, it changes when the index is rebuilt.
             uint32 bucketId;
+            // Entry the item lives in. Stays the same for the whole lifetime of the item.
             uint32 itemId;
         };
         uint64 id;
     };
 
-    template <typename U, typename T, typename size_type>
-    struct hashtablebucket
+    // Control byte of an index slot: empty, deleted or the low 7 bits of the item hash when in use.
+    enum : uint8 { hashtable_ctrlEmpty = 0x80, hashtable_ctrlDeleted = 0xfe };
+
+    // Portable group matching, one result bit per slot.
+    struct hashtablegroupscalar
     {
-        U* keys = nullptr;
-        T* items = nullptr;
-        size_type size = 0;
-        size_type count = 0;
-        size_type next = TypeLimit<size_type>::max();
-        uint64 usedFlags = 0;
+        static constexpr uint32 width = 16;
+
+        explicit hashtablegroupscalar(const uint8* _ctrl) : ctrl(_ctrl) {}
+
+        uint32 match(uint8 value) const
+        {
+            uint32 mask = 0;
+            for (uint32 i = 0; i < width; ++i)
+                mask |= static_cast<uint32>(ctrl[i] == value) << i;
+            return mask;
+        }
+
+        uint32 matchEmpty() const { return match(hashtable_ctrlEmpty); }
+
+        // empty or deleted, both have the high bit set
+        uint32 matchFree() const
+        {
+            uint32 mask = 0;
+            for (uint32 i = 0; i < width; ++i)
+                mask |= static_cast<uint32>(ctrl[i] >> 7) << i;
+            return mask;
+        }
+
+        const uint8* ctrl;
     };
 
+#ifdef CODA_X86_64
+    struct hashtablegroupsse2
+    {
+        static constexpr uint32 width = 16;
+
+        explicit hashtablegroupsse2(const uint8* ctrl) : bytes(_mm_loadu_si128(reinterpret_cast<const __m128i*>(ctrl))) {}
+
+        uint32 match(uint8 value) const { return static_cast<uint32>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(static_cast<char>(value)), bytes))); }
+        uint32 matchEmpty() const { return match(hashtable_ctrlEmpty); }
+        uint32 matchFree() const { return static_cast<uint32>(_mm_movemask_epi8(bytes)); }
+
+        __m128i bytes;
+    };
+#endif
+
+    /**
+     * Open addressing hashtable.
+     * Keys and items live in entry segments that are never moved once allocated, so pointers and
+     * hashtableitemid handles stay valid until the item is destroyed. Segments double in size, so a
+     * table holding n items costs O(log n) entry allocations.
+     * Lookups go through an index of control bytes (empty, deleted or the low 7 bits of the hash)
+     * plus the entry each slot points to. Probes compare 16 (SSE2) or 32 (AVX2) control bytes at once,
+     * picked at runtime with a scalar fallback, so a lookup rarely compares more than one key.
+     *
+     * The index doubles once the load factor reaches getMaxLoadFactor(). Items are moved from the
+     * old index to the new one a few slots at a time on later createItem/destroyItem calls (or
+     * rehashStep), and lookups check both indices meanwhile, so growing never stalls a single call.
+     */
     template <typename KeyType, typename ItemType, typename AllocatorType = coda::baseallocator, typename size_type = uint32>
-    class hashtable
+    class hashtable : private allocatorholder<AllocatorType>
     {
+        typedef allocatorholder<AllocatorType> allocator_holder;
         static constexpr size_type invalidIndex = TypeLimit<size_type>::max();
+        static constexpr uint8 ctrlEmpty = hashtable_ctrlEmpty;
+        static constexpr uint8 ctrlDeleted = hashtable_ctrlDeleted;
+        // Control bytes mirrored past the end so a group can be loaded from any slot
+        static constexpr size_type ctrlCloneCount = 32;
+        static constexpr size_type minBucketCount = ctrlCloneCount;
+        static constexpr size_type minSegmentSize = 16;
     public:
-        typedef hashtablebucket<KeyType, ItemType, size_type> buckettype;
+        static constexpr float defaultMaxLoadFactor = 0.875f;
+        // Old index slots migrated on each mutation while rehashing.
+        static constexpr size_type rehashStepSize = 32;
 
-        hashtable(size_type _size = 1024);
+        hashtable(size_type _size = 1024, float _maxLoadFactor = defaultMaxLoadFactor, const AllocatorType& allocator = AllocatorType());
         ~hashtable();
 
+        hashtable(const hashtable&) = delete;
+        hashtable& operator=(const hashtable&) = delete;
+
         ItemType* createItem(const KeyType& key, const ItemType& item);
-        hashtableitemid findId(const KeyType& key) const;
+        // Lookups take any key marked with is_hash_compatible as is (e.g. a stringview for string
+        // keys), other types are converted to KeyType first.
+        template <typename LookupType = KeyType>
+        hashtableitemid findId(const LookupType& key) const;
         ItemType* getById(hashtableitemid id) const;
-        ItemType* findItem(const KeyType& key) const;
-        bool contains(const KeyType& key) const;
+        template <typename LookupType = KeyType>
+        ItemType* findItem(const LookupType& key) const;
+        template <typename LookupType = KeyType>
+        bool contains(const LookupType& key) const;
         void destroyItem(const KeyType& key);
 
+        // Forward iteration over the items in storage order, see iteratorbase
+        template <bool Const>
+        class iteratorbase;
+        typedef iteratorbase<false> iterator;
+        typedef iteratorbase<true> const_iterator;
+
+        iterator begin() { return iterator(this); }
+        iterator end() { return iterator(); }
+        const_iterator begin() const { return const_iterator(this); }
+        const_iterator end() const { return const_iterator(); }
+        // Destroys the item at it and returns the iterator to the next one
+        iterator erase(iterator it);
+
+        // count / bucket count. The index grows when this reaches getMaxLoadFactor().
         float getLoadFactor() const;
+        float getMaxLoadFactor() const { return maxLoadFactor; }
+        // Takes effect the next time the index grows.
+        void setMaxLoadFactor(float factor);
+
+        bool isRehashing() const { return oldIndex.bucketCount != 0; }
+        // Migrates up to slotCount slots of the old index, if a rehash is in progress.
+        void rehashStep(size_type slotCount = rehashStepSize);
+        void finishRehash();
 
+        // Number of items the table holds before the index grows.
         size_type getSize() const { return size; }
         size_type getCount() const { return count; }
+        // Number of slots in the index, always a power of two.
+        size_type getBucketCount() const { return index.bucketCount; }
+
+#if CODA_INSTRUMENTATION
+        const hashtablestats& getStats() const { return stats; }
+#else
+        // Never updated
+        const hashtablestats& getStats() const { static const hashtablestats empty; return empty; }
+#endif
+
+        using allocator_holder::getAllocator;
 
     private:
+        template <typename, typename, typename, typename>
+        friend class concurrenthashtable;
+
+        struct indextype
+        {
+            uint8* ctrl = nullptr;
+            size_type* slots = nullptr;
+            size_type bucketCount = 0;
+        };
+
+        struct segmenttype
+        {
+            KeyType* keys;
+            ItemType* items;
+            uint64* hashes;
+            uint64* usedFlags;
+        };
+
+        template <typename LookupType>
+        using lookup_key = typename std::conditional<is_hash_compatible<KeyType, typename std::decay<const LookupType>::type>::value,
+            typename std::decay<const LookupType>::type, KeyType>::type;
+
+        template <typename LookupType>
+        static uint64 getHash(const LookupType& key);
+        ItemType* createItem(const KeyType& key, const ItemType& item, uint64 hash);
+        bool destroyItem(const KeyType& key, uint64 hash);
+        void destroyEntry(size_type entry);
+        static uint8 getFragment(uint64 hash) { return static_cast<uint8>(hash & 0x7f); }
+        static bool isFull(uint8 c) { return c < ctrlEmpty; }
+        static size_type getIndex(const indextype& idx, uint64 hash) { return static_cast<size_type>((hash >> 7) & (idx.bucketCount - 1)); }
+        size_type getMaxLoad(size_type buckets) const;
 
-        size_type getIndex(const KeyType& key) const;
-        void linkItem(size_type index);
+        void allocateIndex(indextype& idx, size_type buckets);
+        void releaseIndex(indextype& idx);
+        static void setCtrl(indextype& idx, size_type slot, uint8 value);
+        template <typename LookupType>
+        size_type findSlot(const indextype& idx, const LookupType& key, uint64 hash) const;
+        template <typename GroupType, typename LookupType>
+        size_type findSlotGroup(const indextype& idx, const LookupType& key, uint64 hash) const;
+#ifdef CODA_X86_64
+        template <typename LookupType>
+        CODA_TARGET_AVX2 size_type findSlotAVX2(const indextype& idx, const LookupType& key, uint64 hash) const;
+#endif
+        static size_type findFreeSlot(const indextype& idx, uint64 hash);
+        template <typename GroupType>
+        static size_type findFreeSlotGroup(const indextype& idx, uint64 hash);
+        void insertSlot(uint64 hash, size_type entry);
+        void eraseSlot(indextype& idx, size_type slot);
+        template <typename LookupType>
+        size_type findEntry(const LookupType& key, uint64 hash, size_type& slot) const;
+        // Slot of idx pointing to entry, found by hash rather than key since keys may repeat
+        static size_type findEntrySlot(const indextype& idx, size_type entry, uint64 hash);
+        void grow();
+        void rebuildIndex();
 
+        size_type getSegmentSize(size_type segment) const { return size_type(1) << (segmentShift + (segment ? segment - 1 : 0)); }
+        size_type getSegmentStart(size_type segment) const { return segment ? size_type(1) << (segmentShift + segment - 1) : 0; }
+        const segmenttype& getSegment(size_type entry, size_type& offset) const;
+        KeyType& getKey(size_type entry) const { size_type o; return getSegment(entry, o).keys[o]; }
+        ItemType& getItem(size_type entry) const { size_type o; return getSegment(entry, o).items[o]; }
+        uint64 getEntryHash(size_type entry) const { size_type o; return getSegment(entry, o).hashes[o]; }
+        bool isUsedEntry(size_type entry) const;
+        template <typename Function>
+        void forEachEntry(Function function) const;
+        void addSegment();
+        size_type allocateEntry(uint64 hash);
+        void releaseEntry(size_type entry);
+
+        template <typename T>
+        T* allocateArray(size_type count);
+        template <typename T>
+        void releaseArray(T* data);
+
+#if CODA_INSTRUMENTATION
+        // Calls function(hashtablestats&) on the table stats and the thread ones
+        template <typename Function>
+        void record(Function function) const
+        {
+            function(stats);
+            function(instrumentation::getThreadStats().hashtable);
+        }
+#endif
 
     private:
-        buckettype* buckets;
+        indextype index;
+        indextype oldIndex;
+        size_type migrateCursor;
+        size_type growthLeft;
+        float maxLoadFactor;
+
+        segmenttype* segments;
+        size_type segmentCount;
+        size_type segmentShift;
+        size_type entryCount;
+        size_type freeEntry;
+
         size_type count;
         size_type size;
-        size_type first;
+
+#if CODA_INSTRUMENTATION
+        mutable hashtablestats stats;
+#endif
+
+    public:
+        /**
+         * Walks the entry segments in order, skipping free entries 64 at a time with a bitscan of the
+         * used flags, so a full scan reads the storage sequentially. Dereferencing gives the key and
+         * item of the entry. Destroying items keeps iterators valid, the ones destroyed ahead of an
+         * iterator are not visited. Creating items does not.
+         */
+        template <bool Const>
+        class iteratorbase
+        {
+            typedef typename std::conditional<Const, const hashtable, hashtable>::type table_type;
+            typedef typename std::conditional<Const, const ItemType, ItemType>::type item_type;
+            friend class hashtable;
+        public:
+            struct entry
+            {
+                const KeyType& key;
+                item_type& item;
+            };
+            struct arrow
+            {
+                entry value;
+                const entry* operator->() const { return &value; }
+            };
+
+            typedef std::forward_iterator_tag iterator_category;
+            typedef entry value_type;
+            typedef entry reference;
+            typedef arrow pointer;
+            typedef std::ptrdiff_t difference_type;
+
+            // end iterator
+            iteratorbase() : segment(nullptr), segmentIndex(0), segmentCount(0), word(0), wordCount(0), offset(0), bits(0) {}
+            // iterator converts to const_iterator
+            template <bool OtherConst, typename = typename std::enable_if<Const && !OtherConst>::type>
+            iteratorbase(const iteratorbase<OtherConst>& other)
+                : segment(other.segment), segmentIndex(other.segmentIndex), segmentCount(other.segmentCount), table(other.table),
+                word(other.word), wordCount(other.wordCount), offset(other.offset), bits(other.bits) {}
+
+            const KeyType& getKey() const { return segment->keys[offset]; }
+            item_type& getItem() const { return segment->items[offset]; }
+
+            entry operator*() const { return { getKey(), getItem() }; }
+            arrow operator->() const { return { **this }; }
+
+            iteratorbase& operator++()
+            {
+                // the flags are read again since items after this one may have been destroyed
+                bits = segment->usedFlags[word] & ~((uint64(2) << (offset & 63)) - 1);
+                seek();
+                return *this;
+            }
+
+            iteratorbase operator++(int)
+            {
+                iteratorbase it = *this;
+                ++*this;
+                return it;
+            }
+
+            bool operator==(const iteratorbase& other) const { return segment == other.segment && offset == other.offset; }
+            bool operator!=(const iteratorbase& other) const { return !(*this == other); }
+
+        private:
+            template <bool>
+            friend class iteratorbase;
+
+            explicit iteratorbase(table_type* _table)
+                : segment(_table->segments), segmentIndex(0), segmentCount(_table->segmentCount), table(_table), word(0), wordCount(0), offset(0), bits(0)
+            {
+                if (!segmentCount)
+                {
+                    segment = nullptr;
+                    return;
+                }
+                wordCount = (table->getSegmentSize(0) + 63) / 64;
+                bits = segment->usedFlags[0];
+                seek();
+            }
+
+            // Moves to the first used entry from the current bits on, or to the end
+            void seek()
+            {
+                while (!bits)
+                {
+                    if (++word == wordCount)
+                    {
+                        if (++segmentIndex == segmentCount)
+                        {
+                            *this = iteratorbase();
+                            return;
+                        }
+                        ++segment;
+                        word = 0;
+                        wordCount = (table->getSegmentSize(segmentIndex) + 63) / 64;
+                    }
+                    bits = segment->usedFlags[word];
+                }
+                offset = word * 64 + bitScanForward(bits);
+            }
+
+            // Global entry index, for erase
+            size_type getEntry() const { return table->getSegmentStart(segmentIndex) + offset; }
+
+        private:
+            const segmenttype* segment;
+            size_type segmentIndex;
+            size_type segmentCount;
+            table_type* table = nullptr;
+            size_type word;
+            size_type wordCount;
+            size_type offset;
+            uint64 bits;
+        };
     };
 
     template<typename KeyType, typename ItemType, typename AllocatorType, typename size_type>
-    inline hashtable<KeyType, ItemType, AllocatorType, size_type>::hashtable(size_type _size)
-        : buckets(nullptr), count(0), size(_size), first(invalidIndex)
+    inline hashtable<KeyType, ItemType, AllocatorType, size_type>::hashtable(size_type _size, float _maxLoadFactor, const AllocatorType& allocator)
+        : allocator_holder(allocator), migrateCursor(0), growthLeft(0), maxLoadFactor(_maxLoadFactor),
+        segments(nullptr), segmentCount(0), segmentShift(0), entryCount(0), freeEntry(invalidIndex),
+        count(0), size(0)
     {
-        // todo: check is valid size
+        coda_assert(_size > 0 && _size < hashtable_invalidId);
+        setMaxLoadFactor(_maxLoadFactor);
+
+        size_type buckets = minBucketCount;
+        while (getMaxLoad(buckets) < _size)
+            buckets <<= 1;
+        allocateIndex(index, buckets);
+        size = growthLeft = getMaxLoad(buckets);
 
-        buckets = (buckettype*)AllocatorType::allocate(size * sizeof(buckettype));
-        for (size_type i = 0; i < size; ++i)
-            new (&buckets[i]) buckettype();
+        segmentShift = bitScanReverse(_size > minSegmentSize ? _size - 1 : minSegmentSize - 1) + 1;
     }
 
     template<typename KeyType, typename ItemType, typename AllocatorType, typename size_type>
     inline hashtable<KeyType, ItemType, AllocatorType, size_type>::~hashtable()
     {
-        size_type it = first;
-        while (it != invalidIndex)
+        forEachEntry([this](size_type entry)
+            {
+                getItem(entry).~ItemType();
+                getKey(entry).~KeyType();
+            });
+        for (size_type i = 0; i < segmentCount; ++i)
+        {
+            releaseArray(segments[i].usedFlags);
+            releaseArray(segments[i].hashes);
+            releaseArray(segments[i].items);
+            releaseArray(segments[i].keys);
+        }
+        if (segments)
+            releaseArray(segments);
+        releaseIndex(oldIndex);
+        releaseIndex(index);
+    }
+
+    template<typename KeyType, typename ItemType, typename AllocatorType, typename size_type>
+    inline ItemType* hashtable<KeyType, ItemType, AllocatorType, size_type>::createItem(const KeyType& key, const ItemType& item)
+    {
+        return createItem(key, item, getHash(key));
+    }
+
+    template<typename KeyType, typename ItemType, typename AllocatorType, typename size_type>
+    inline ItemType* hashtable<KeyType, ItemType, AllocatorType, size_type>::createItem(const KeyType& key, const ItemType& item, uint64 hash)
+    {
+        if (count == size)
+            grow();
+        else
+            rehashStep();
+
+        size_type entry = allocateEntry(hash);
+        new (&getKey(entry)) KeyType(key);
+        ItemType* ret = new (&getItem(entry)) ItemType(item);
+        insertSlot(hash, entry);
+        ++count;
+        coda_instrument(record([](hashtablestats& s) { s.inserts.add(); }));
+        return ret;
+    }
+
+    template<typename KeyType, typename ItemType, typename AllocatorType, typename size_type>
+    template<typename LookupType>
+    inline hashtableitemid hashtable<KeyType, ItemType, AllocatorType, size_type>::findId(const LookupType& key) const
+    {
+        const lookup_key<LookupType>& lookupKey = key;
+        size_type slot;
+        size_type entry = findEntry(lookupKey, getHash(lookupKey), slot);
+        if (entry != invalidIndex)
+        {
+            hashtableitemid id;
+            id.bucketId = static_cast<uint32>(slot);
+            id.itemId = static_cast<uint32>(entry);
+            return id;
+        }
+        return {hashtable_invalidId};
+    }
+
+    template<typename KeyType, typename ItemType, typename AllocatorType, typename size_type>
+    inline ItemType* hashtable<KeyType, ItemType, AllocatorType, size_type>::getById(hashtableitemid id) const
+    {
+        if (id.id != hashtable_invalidId && id.itemId < entryCount && isUsedEntry(id.itemId))
+            return &getItem(id.itemId);
+        return nullptr;
+    }
+
+    template<typename KeyType, typename ItemType, typename AllocatorType, typename size_type>
+    template<typename LookupType>
+    inline ItemType* hashtable<KeyType, ItemType, AllocatorType, size_type>::findItem(const LookupType& key) const
+    {
+        const lookup_key<LookupType>& lookupKey = key;
+        size_type slot;
+        size_type entry = findEntry(lookupKey, getHash(lookupKey), slot);
+        return entry != invalidIndex ? &getItem(entry) : nullptr;
+    }
+
+    template<typename KeyType, typename ItemType, typename AllocatorType, typename size_type>
+    template<typename LookupType>
+    inline bool hashtable<KeyType, ItemType, AllocatorType, size_type>::contains(const LookupType& key) const
+    {
+        const lookup_key<LookupType>& lookupKey = key;
+        size_type slot;
+        return findEntry(lookupKey, getHash(lookupKey), slot) != invalidIndex;
+    }
+
+    template<typename KeyType, typename ItemType, typename AllocatorType, typename size_type>
+    inline void hashtable<KeyType, ItemType, AllocatorType, size_type>::destroyItem(const KeyType& key)
+    {
+        destroyItem(key, getHash(key));
+    }
+
+    template<typename KeyType, typename ItemType, typename AllocatorType, typename size_type>
+    inline bool hashtable<KeyType, ItemType, AllocatorType, size_type>::destroyItem(const KeyType& key, uint64 hash)
+    {
+        rehashStep();
+
+        size_type entry = invalidIndex;
+        size_type slot = findSlot(index, key, hash);
+        if (slot != invalidIndex)
+        {
+            entry = index.slots[slot];
+            eraseSlot(index, slot);
+        }
+        else if (isRehashing())
         {
-            for (size_type i = 0; i < buckets[it].count; ++i)
+            slot = findSlot(oldIndex, key, hash);
+            if (slot != invalidIndex)
             {
-                buckets[it].items[i].~ItemType();
-                buckets[it].keys[i].~KeyType();
+                entry = oldIndex.slots[slot];
+                setCtrl(oldIndex, slot, ctrlDeleted);
             }
-            AllocatorType::release(buckets[it].items);
-            AllocatorType::release(buckets[it].keys);
-            it = buckets[it].next;
         }
-        AllocatorType::release(buckets);
+
+        if (entry != invalidIndex)
+        {
+            destroyEntry(entry);
+            return true;
+        }
+        return false;
     }
 
     template<typename KeyType, typename ItemType, typename AllocatorType, typename size_type>
-    inline ItemType* hashtable<KeyType, ItemType, AllocatorType, size_type>::createItem(const KeyType& key, const ItemType& item)
+    inline void hashtable<KeyType, ItemType, AllocatorType, size_type>::destroyEntry(size_type entry)
+    {
+        getItem(entry).~ItemType();
+        getKey(entry).~KeyType();
+        releaseEntry(entry);
+        coda_dbg_assert(count);
+        --count;
+        coda_instrument(record([](hashtablestats& s) { s.erases.add(); }));
+    }
+
+    template<typename KeyType, typename ItemType, typename AllocatorType, typename size_type>
+    inline typename hashtable<KeyType, ItemType, AllocatorType, size_type>::iterator hashtable<KeyType, ItemType, AllocatorType, size_type>::erase(iterator it)
     {
-        coda_assert(count < size);
-        size_type i = getIndex(key);
-        ItemType* ret = nullptr;
-        buckettype& bucket = buckets[i];
-        // no collision case
-        if (!bucket.items)
+        coda_assert(it != end());
+        rehashStep();
+
+        // keys may repeat, the slot is the one pointing to this very entry
+        const size_type entry = it.getEntry();
+        const uint64 hash = getEntryHash(entry);
+        size_type slot = findEntrySlot(index, entry, hash);
+        if (slot != invalidIndex)
         {
-            bucket.size = 3;
-            bucket.count = 1;
-            bucket.items = (ItemType*)AllocatorType::allocate(sizeof(ItemType) * bucket.size);
-            bucket.keys = (KeyType*)AllocatorType::allocate(sizeof(KeyType) * bucket.size);
-            bucket.usedFlags = 0x1;
-            ret = bucket.items;
-            new (ret) ItemType(item);
-            new (bucket.keys) KeyType(key);
-            linkItem(i);
+            eraseSlot(index, slot);
         }
         else
         {
-            size_type freeSlot = invalidIndex;
-            // collision case
-            if (bucket.count == bucket.size)
-			{
-                // search for free slot
-                for (size_type i = 0; i < bucket.count; ++i)
-                {
-                    if (!(bucket.usedFlags & (1i64 << i)))
-                    {
-                        freeSlot = i;
-                        break;
-                    }
-                }
+            coda_assert(isRehashing());
+            slot = findEntrySlot(oldIndex, entry, hash);
+            coda_assert(slot != invalidIndex);
+            setCtrl(oldIndex, slot, ctrlDeleted);
+        }
+        destroyEntry(entry);
+        return ++it;
+    }
+
+	template<typename KeyType, typename ItemType, typename AllocatorType, typename size_type>
+	inline float hashtable<KeyType, ItemType, AllocatorType, size_type>::getLoadFactor() const
+	{
+        return static_cast<float>(count) / static_cast<float>(index.bucketCount);
+	}
+
+    template<typename KeyType, typename ItemType, typename AllocatorType, typename size_type>
+    inline void hashtable<KeyType, ItemType, AllocatorType, size_type>::setMaxLoadFactor(float factor)
+    {
+        coda_assert(factor > 0.f && factor < 1.f);
+        maxLoadFactor = factor;
+    }
 
-                if (freeSlot == invalidIndex)
+    template<typename KeyType, typename ItemType, typename AllocatorType, typename size_type>
+    inline void hashtable<KeyType, ItemType, AllocatorType, size_type>::rehashStep(size_type slotCount)
+    {
+        if (!isRehashing())
+            return;
+
+        size_type end = oldIndex.bucketCount - migrateCursor > slotCount ? migrateCursor + slotCount : oldIndex.bucketCount;
+        for (; migrateCursor < end; ++migrateCursor)
+        {
+            uint8 c = oldIndex.ctrl[migrateCursor];
+            if (isFull(c))
+            {
+                // keep the slot as a tombstone so probes for items not migrated yet still walk past it
+                setCtrl(oldIndex, migrateCursor, ctrlDeleted);
+                size_type entry = oldIndex.slots[migrateCursor];
+                insertSlot(getEntryHash(entry), entry);
+                coda_instrument(record([](hashtablestats& s) { s.migratedSlots.add(); }));
+                // running out of free slots rebuilds the whole index, which completes the rehash
+                if (!isRehashing())
+                    return;
+            }
+        }
+        if (migrateCursor == oldIndex.bucketCount)
+            releaseIndex(oldIndex);
+    }
+
+    template<typename KeyType, typename ItemType, typename AllocatorType, typename size_type>
+    inline void hashtable<KeyType, ItemType, AllocatorType, size_type>::finishRehash()
+    {
+        if (isRehashing())
+            rehashStep(oldIndex.bucketCount);
+    }
+
+    template<typename KeyType, typename ItemType, typename AllocatorType, typename size_type>
+    template<typename LookupType>
+    inline uint64 hashtable<KeyType, ItemType, AllocatorType, size_type>::getHash(const LookupType& key)
+    {
+        // the bucket index comes from the high bits and the control byte from the low ones, hasher
+        // results are mixed well enough for both
+        return hash_function(key);
+    }
+
+    template<typename KeyType, typename ItemType, typename AllocatorType, typename size_type>
+    inline size_type hashtable<KeyType, ItemType, AllocatorType, size_type>::getMaxLoad(size_type buckets) const
+    {
+        size_type maxLoad = static_cast<size_type>(static_cast<double>(buckets) * maxLoadFactor);
+        // an empty slot must always remain to end the probes
+        return maxLoad < buckets ? (maxLoad ? maxLoad : 1) : buckets - 1;
+    }
+
+    template<typename KeyType, typename ItemType, typename AllocatorType, typename size_type>
+    inline void hashtable<KeyType, ItemType, AllocatorType, size_type>::allocateIndex(indextype& idx, size_type buckets)
+    {
+        coda_assert(buckets && !(buckets & (buckets - 1)));
+        idx.ctrl = allocateArray<uint8>(buckets + ctrlCloneCount);
+        idx.slots = allocateArray<size_type>(buckets);
+        idx.bucketCount = buckets;
+        memset(idx.ctrl, ctrlEmpty, buckets + ctrlCloneCount);
+    }
+
+    template<typename KeyType, typename ItemType, typename AllocatorType, typename size_type>
+    inline void hashtable<KeyType, ItemType, AllocatorType, size_type>::releaseIndex(indextype& idx)
+    {
+        if (!idx.bucketCount)
+            return;
+        releaseArray(idx.slots);
+        releaseArray(idx.ctrl);
+        idx = indextype();
+    }
+
+    template<typename KeyType, typename ItemType, typename AllocatorType, typename size_type>
+    inline void hashtable<KeyType, ItemType, AllocatorType, size_type>::setCtrl(indextype& idx, size_type slot, uint8 value)
+    {
+        idx.ctrl[slot] = value;
+        if (slot < ctrlCloneCount)
+            idx.ctrl[idx.bucketCount + slot] = value;
+    }
+
+    template<typename KeyType, typename ItemType, typename AllocatorType, typename size_type>
+    template<typename LookupType>
+    inline size_type hashtable<KeyType, ItemType, AllocatorType, size_type>::findSlot(const indextype& idx, const LookupType& key, uint64 hash) const
+    {
+#ifdef CODA_X86_64
+        const cpufeatures& features = getCpuFeatures();
+        if (features.avx2)
+            return findSlotAVX2(idx, key, hash);
+        if (features.sse2)
+            return findSlotGroup<hashtablegroupsse2>(idx, key, hash);
+#endif
+        return findSlotGroup<hashtablegroupscalar>(idx, key, hash);
+    }
+
+    template<typename KeyType, typename ItemType, typename AllocatorType, typename size_type>
+    template<typename GroupType, typename LookupType>
+    inline size_type hashtable<KeyType, ItemType, AllocatorType, size_type>::findSlotGroup(const indextype& idx, const LookupType& key, uint64 hash) const
+    {
+        // Items sit in the first free slot from their home slot on, so no empty slot lies between the
+        // two and a probe can stop after the first group holding one.
+        const uint8 fragment = getFragment(hash);
+        const size_type mask = idx.bucketCount - 1;
+        const size_type home = getIndex(idx, hash);
+        for (size_type pos = home; ; pos = (pos + GroupType::width) & mask)
+        {
+            GroupType group(idx.ctrl + pos);
+            for (uint32 bits = group.match(fragment); bits; bits &= bits - 1)
+            {
+                size_type slot = (pos + bitScanForward(bits)) & mask;
+                if (getKey(idx.slots[slot]) == key)
                 {
-                    // reallocate
-                    ++bucket.size;
-                    coda_assert(bucket.size <= sizeof(bucket.usedFlags) * 8);
-                    ItemType* items = (ItemType*)AllocatorType::reallocate(bucket.items, sizeof(ItemType) * bucket.size);
-                    coda_assert(items);
-                    bucket.items = items;
-
-                    KeyType* keys = (KeyType*)AllocatorType::reallocate(bucket.keys, sizeof(KeyType) * bucket.size);
-                    coda_assert(keys);
-                    bucket.keys = keys;
-
-                    freeSlot = bucket.count;
-                    ++bucket.count;
+                    coda_instrument(record([&](hashtablestats& s) { s.recordProbe(((pos - home) & mask) / GroupType::width + 1, true); }));
+                    return slot;
                 }
             }
-            else
+            if (group.matchEmpty())
             {
-                freeSlot = bucket.count++;
+                coda_instrument(record([&](hashtablestats& s) { s.recordProbe(((pos - home) & mask) / GroupType::width + 1, false); }));
+                return invalidIndex;
             }
-            coda_assert(freeSlot != invalidIndex);
-            coda_assert(freeSlot < bucket.size);
-            ret = &bucket.items[freeSlot];
-            new (ret) ItemType(item);
-            new (&bucket.keys[freeSlot]) KeyType(key);
-            bucket.usedFlags |= (1i64 << (freeSlot));
         }
-        coda_assert(ret);
-        ++count;
-        return ret;
     }
 
+#ifdef CODA_X86_64
     template<typename KeyType, typename ItemType, typename AllocatorType, typename size_type>
-    inline hashtableitemid hashtable<KeyType, ItemType, AllocatorType, size_type>::findId(const KeyType& key) const
+    template<typename LookupType>
+    CODA_TARGET_AVX2 inline size_type hashtable<KeyType, ItemType, AllocatorType, size_type>::findSlotAVX2(const indextype& idx, const LookupType& key, uint64 hash) const
     {
-        hashtableitemid id = {hashtable_invalidId};
-        size_type index = getIndex(key);
-        if (buckets[index].items)
+        // same probe as findSlotGroup, two 16 slot groups per step
+        const __m256i fragment = _mm256_set1_epi8(static_cast<char>(getFragment(hash)));
+        const __m256i empty = _mm256_set1_epi8(static_cast<char>(ctrlEmpty));
+        const size_type mask = idx.bucketCount - 1;
+        const size_type home = getIndex(idx, hash);
+        for (size_type pos = home; ; pos = (pos + 32) & mask)
         {
-            id.bucketId = index;
-            if (buckets[index].count > 1)
+            __m256i group = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(idx.ctrl + pos));
+            for (uint32 bits = static_cast<uint32>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(fragment, group))); bits; bits &= bits - 1)
             {
-                for (size_type i = 0; i < buckets[index].count; ++i)
+                size_type slot = (pos + bitScanForward(bits)) & mask;
+                if (getKey(idx.slots[slot]) == key)
                 {
-                    if (key == buckets[index].keys[i])
-                    {
-                        id.itemId = i;
-                        coda_assert(buckets[index].usedFlags & (1i64 << i));
-                        return id;
-                    }
+                    coda_instrument(record([&](hashtablestats& s) { s.recordProbe(((pos - home) & mask) / 32 + 1, true); }));
+                    return slot;
                 }
             }
-            else
+            if (_mm256_movemask_epi8(_mm256_cmpeq_epi8(empty, group)))
             {
-                if (key == buckets[index].keys[0])
-                {
-                    id.itemId = 0;
-                    coda_assert(buckets[index].usedFlags & 1i64);
-                    return id;
-                }
+                coda_instrument(record([&](hashtablestats& s) { s.recordProbe(((pos - home) & mask) / 32 + 1, false); }));
+                return invalidIndex;
             }
         }
-        return {hashtable_invalidId};
     }
+#endif
 
     template<typename KeyType, typename ItemType, typename AllocatorType, typename size_type>
-    inline ItemType* hashtable<KeyType, ItemType, AllocatorType, size_type>::getById(hashtableitemid id) const
+    inline size_type hashtable<KeyType, ItemType, AllocatorType, size_type>::findFreeSlot(const indextype& idx, uint64 hash)
+    {
+#ifdef CODA_X86_64
+        if (getCpuFeatures().sse2)
+            return findFreeSlotGroup<hashtablegroupsse2>(idx, hash);
+#endif
+        return findFreeSlotGroup<hashtablegroupscalar>(idx, hash);
+    }
+
+    template<typename KeyType, typename ItemType, typename AllocatorType, typename size_type>
+    template<typename GroupType>
+    inline size_type hashtable<KeyType, ItemType, AllocatorType, size_type>::findFreeSlotGroup(const indextype& idx, uint64 hash)
+    {
+        const size_type mask = idx.bucketCount - 1;
+        for (size_type pos = getIndex(idx, hash); ; pos = (pos + GroupType::width) & mask)
+        {
+            uint32 bits = GroupType(idx.ctrl + pos).matchFree();
+            if (bits)
+                return (pos + bitScanForward(bits)) & mask;
+        }
+    }
+
+    template<typename KeyType, typename ItemType, typename AllocatorType, typename size_type>
+    inline void hashtable<KeyType, ItemType, AllocatorType, size_type>::insertSlot(uint64 hash, size_type entry)
     {
-        if (id.id != hashtable_invalidId && id.bucketId < size)
+        size_type slot = findFreeSlot(index, hash);
+        if (index.ctrl[slot] == ctrlEmpty)
         {
-            const buckettype& bucket = buckets[id.bucketId];
-            if (id.itemId < bucket.count && bucket.usedFlags & (1i64 <<id.itemId))
+            // only deleted slots left, drop the tombstones. The rebuild indexes every used entry,
+            // this one included.
+            if (!growthLeft)
             {
-                return &bucket.items[id.itemId];
+                rebuildIndex();
+                return;
             }
+            --growthLeft;
         }
-        return nullptr;
+        setCtrl(index, slot, getFragment(hash));
+        index.slots[slot] = entry;
     }
 
     template<typename KeyType, typename ItemType, typename AllocatorType, typename size_type>
-    inline ItemType* hashtable<KeyType, ItemType, AllocatorType, size_type>::findItem(const KeyType& key) const
+    inline void hashtable<KeyType, ItemType, AllocatorType, size_type>::eraseSlot(indextype& idx, size_type slot)
     {
-        hashtableitemid id = findId(key);
-        return getById(id);
+        // a probe only walks past this slot when the next one is in use, otherwise it can become empty again
+        if (idx.ctrl[(slot + 1) & (idx.bucketCount - 1)] == ctrlEmpty)
+        {
+            setCtrl(idx, slot, ctrlEmpty);
+            ++growthLeft;
+        }
+        else
+        {
+            setCtrl(idx, slot, ctrlDeleted);
+        }
     }
 
     template<typename KeyType, typename ItemType, typename AllocatorType, typename size_type>
-    inline bool hashtable<KeyType, ItemType, AllocatorType, size_type>::contains(const KeyType& key) const
+    template<typename LookupType>
+    inline size_type hashtable<KeyType, ItemType, AllocatorType, size_type>::findEntry(const LookupType& key, uint64 hash, size_type& slot) const
     {
-        hashtableitemid id = findId(key);
-        return id.id != hashtable_invalidId;
+        slot = findSlot(index, key, hash);
+        if (slot != invalidIndex)
+            return index.slots[slot];
+        if (isRehashing())
+        {
+            slot = findSlot(oldIndex, key, hash);
+            if (slot != invalidIndex)
+                return oldIndex.slots[slot];
+        }
+        return invalidIndex;
     }
 
     template<typename KeyType, typename ItemType, typename AllocatorType, typename size_type>
-    inline void hashtable<KeyType, ItemType, AllocatorType, size_type>::destroyItem(const KeyType& key)
+    inline size_type hashtable<KeyType, ItemType, AllocatorType, size_type>::findEntrySlot(const indextype& idx, size_type entry, uint64 hash)
     {
-        hashtableitemid id = findId(key);
-        if (id.id != hashtable_invalidId)
+        const uint8 fragment = getFragment(hash);
+        const size_type mask = idx.bucketCount - 1;
+        for (size_type slot = getIndex(idx, hash); idx.ctrl[slot] != ctrlEmpty; slot = (slot + 1) & mask)
         {
-            buckettype& bucket = buckets[id.bucketId];
-            coda_assert(bucket.size > id.itemId);
-            coda_assert(bucket.usedFlags & (1i64 << id.itemId));
-            ItemType* item = &bucket.items[id.itemId];
-            item->~ItemType();
-            bucket.usedFlags &= ~(1i64 << id.itemId);
-            coda_assert(count);
-            --count;
+            if (idx.ctrl[slot] == fragment && idx.slots[slot] == entry)
+                return slot;
         }
+        return invalidIndex;
     }
 
-	template<typename KeyType, typename ItemType, typename AllocatorType, typename size_type>
-	inline float hashtable<KeyType, ItemType, AllocatorType, size_type>::getLoadFactor() const
-	{
-        return count / size;
-	}
+    template<typename KeyType, typename ItemType, typename AllocatorType, typename size_type>
+    inline void hashtable<KeyType, ItemType, AllocatorType, size_type>::grow()
+    {
+        CODA_TRACE_ZONE("hashtable::grow");
+        coda_instrument(record([](hashtablestats& s) { s.rehashes.add(); }));
+        finishRehash();
+        coda_assert(index.bucketCount < (size_type(1) << (sizeof(size_type) * 8 - 1)));
+
+        size_type buckets = index.bucketCount << 1;
+        while (getMaxLoad(buckets) <= count)
+            buckets <<= 1;
+        oldIndex = index;
+        allocateIndex(index, buckets);
+        migrateCursor = 0;
+        size = growthLeft = getMaxLoad(buckets);
+        rehashStep();
+    }
+
+    template<typename KeyType, typename ItemType, typename AllocatorType, typename size_type>
+    inline void hashtable<KeyType, ItemType, AllocatorType, size_type>::rebuildIndex()
+    {
+        CODA_TRACE_ZONE("hashtable::rebuildIndex");
+        coda_instrument(record([](hashtablestats& s) { s.rebuilds.add(); }));
+        releaseIndex(oldIndex);
+        memset(index.ctrl, ctrlEmpty, index.bucketCount + ctrlCloneCount);
+        size_type indexed = 0;
+        forEachEntry([this, &indexed](size_type entry)
+            {
+                uint64 hash = getEntryHash(entry);
+                size_type slot = findFreeSlot(index, hash);
+                setCtrl(index, slot, getFragment(hash));
+                index.slots[slot] = entry;
+                ++indexed;
+            });
+        coda_dbg_assert(indexed <= size);
+        growthLeft = size - indexed;
+    }
+
+    template<typename KeyType, typename ItemType, typename AllocatorType, typename size_type>
+    inline const typename hashtable<KeyType, ItemType, AllocatorType, size_type>::segmenttype& hashtable<KeyType, ItemType, AllocatorType, size_type>::getSegment(size_type entry, size_type& offset) const
+    {
+        // segment 0 holds the first 2^shift entries and every following segment doubles the total
+        size_type high = entry >> segmentShift;
+        size_type segment = high ? bitScanReverse(high) + 1 : 0;
+        offset = entry - getSegmentStart(segment);
+        return segments[segment];
+    }
+
+    template<typename KeyType, typename ItemType, typename AllocatorType, typename size_type>
+    inline bool hashtable<KeyType, ItemType, AllocatorType, size_type>::isUsedEntry(size_type entry) const
+    {
+        size_type offset;
+        const segmenttype& segment = getSegment(entry, offset);
+        return (segment.usedFlags[offset >> 6] >> (offset & 63)) & 1ull;
+    }
+
+    template<typename KeyType, typename ItemType, typename AllocatorType, typename size_type>
+    template<typename Function>
+    inline void hashtable<KeyType, ItemType, AllocatorType, size_type>::forEachEntry(Function function) const
+    {
+        for (size_type s = 0; s < segmentCount; ++s)
+        {
+            const size_type start = getSegmentStart(s);
+            const size_type wordCount = (getSegmentSize(s) + 63) / 64;
+            for (size_type w = 0; w < wordCount; ++w)
+            {
+                for (uint64 bits = segments[s].usedFlags[w]; bits; bits &= bits - 1)
+                    function(start + w * 64 + bitScanForward(bits));
+            }
+        }
+    }
 
     template<typename KeyType, typename ItemType, typename AllocatorType, typename size_type>
-    inline size_type hashtable<KeyType, ItemType, AllocatorType, size_type>::getIndex(const KeyType& key) const
+    inline void hashtable<KeyType, ItemType, AllocatorType, size_type>::addSegment()
     {
-		uint64 h = hash_function(key);
-		return safe_cast<size_type>(h % size);
+        coda_assert(segmentShift + segmentCount <= sizeof(size_type) * 8);
+        segmenttype* newSegments = (segmenttype*)reallocateAligned(getAllocator(), segments, sizeof(segmenttype) * segmentCount,
+            sizeof(segmenttype) * (segmentCount + 1), storage_alignment<segmenttype>::value);
+        coda_assert(newSegments);
+        segments = newSegments;
+
+        const size_type segmentSize = getSegmentSize(segmentCount);
+        const size_type wordCount = (segmentSize + 63) / 64;
+        segmenttype& segment = segments[segmentCount++];
+        segment.keys = allocateArray<KeyType>(segmentSize);
+        segment.items = allocateArray<ItemType>(segmentSize);
+        segment.hashes = allocateArray<uint64>(segmentSize);
+        segment.usedFlags = allocateArray<uint64>(wordCount);
+        memset(segment.usedFlags, 0, wordCount * sizeof(uint64));
     }
 
     template<typename KeyType, typename ItemType, typename AllocatorType, typename size_type>
-    inline void hashtable<KeyType, ItemType, AllocatorType, size_type>::linkItem(size_type index)
+    inline size_type hashtable<KeyType, ItemType, AllocatorType, size_type>::allocateEntry(uint64 hash)
     {
-        coda_assert(index < size && buckets[index].next == invalidIndex);
-        if (first != invalidIndex)
+        size_type entry;
+        size_type offset;
+        if (freeEntry != invalidIndex)
         {
-            size_type it = first;
-            while (buckets[it].next != invalidIndex && index > buckets[it].next)
-                it = buckets[it].next;
-            coda_assert(it < size);
-            buckets[index].next = buckets[it].next;
-            buckets[it].next = index;
+            // released entries keep the next free one in its hash
+            entry = freeEntry;
+            const segmenttype& segment = getSegment(entry, offset);
+            freeEntry = static_cast<size_type>(segment.hashes[offset]);
         }
         else
-            first = index;
+        {
+            if (entryCount == getSegmentStart(segmentCount))
+                addSegment();
+            entry = entryCount++;
+        }
+        const segmenttype& segment = getSegment(entry, offset);
+        segment.usedFlags[offset >> 6] |= 1ull << (offset & 63);
+        segment.hashes[offset] = hash;
+        return entry;
+    }
+
+    template<typename KeyType, typename ItemType, typename AllocatorType, typename size_type>
+    inline void hashtable<KeyType, ItemType, AllocatorType, size_type>::releaseEntry(size_type entry)
+    {
+        size_type offset;
+        const segmenttype& segment = getSegment(entry, offset);
+        coda_paranoid_assert((segment.usedFlags[offset >> 6] >> (offset & 63)) & 1ull);
+        segment.usedFlags[offset >> 6] &= ~(1ull << (offset & 63));
+        segment.hashes[offset] = freeEntry;
+        freeEntry = entry;
+    }
+
+    template<typename KeyType, typename ItemType, typename AllocatorType, typename size_type>
+    template<typename T>
+    inline T* hashtable<KeyType, ItemType, AllocatorType, size_type>::allocateArray(size_type count)
+    {
+        T* data = (T*)allocateAligned(getAllocator(), sizeof(T) * count, storage_alignment<T>::value);
+        coda_assert(data);
+        return data;
+    }
+
+    template<typename KeyType, typename ItemType, typename AllocatorType, typename size_type>
+    template<typename T>
+    inline void hashtable<KeyType, ItemType, AllocatorType, size_type>::releaseArray(T* data)
+    {
+        releaseAligned(getAllocator(), data, storage_alignment<T>::value);
     }
 
-}
\ No newline at end of file
+}
@@ -0,0 +1,237 @@
+#include "instrumentation.h"
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <vector>
+
+namespace coda
+{
+    struct traceevent
+    {
+        const char* name;
+        uint64 start;
+        uint64 duration;
+        uint32 threadId;
+    };
+
+    // Stats and trace events of one thread. std containers so recording never recurses into the
+    // instrumented ones.
+    struct threadrecord
+    {
+        threadrecord();
+        ~threadrecord();
+
+        instrumentationstats stats;
+        std::mutex eventLock;
+        std::vector<traceevent> events;
+        uint32 threadId;
+        threadrecord* prev = nullptr;
+        threadrecord* next = nullptr;
+    };
+
+    // Leaked on purpose, threads may still exit after the static destructors ran
+    struct instrumentationregistry
+    {
+        std::mutex lock;
+        threadrecord* first = nullptr;
+        instrumentationstats retiredStats;
+        std::vector<traceevent> retiredEvents;
+        uint32 nextThreadId = 1;
+    };
+
+    static instrumentationregistry& getRegistry()
+    {
+        static instrumentationregistry* registry = new instrumentationregistry();
+        return *registry;
+    }
+
+    static threadrecord& getThreadRecord()
+    {
+        static thread_local threadrecord record;
+        return record;
+    }
+
+    threadrecord::threadrecord()
+    {
+        instrumentationregistry& registry = getRegistry();
+        std::lock_guard<std::mutex> lock(registry.lock);
+        threadId = registry.nextThreadId++;
+        next = registry.first;
+        if (next)
+            next->prev = this;
+        registry.first = this;
+    }
+
+    threadrecord::~threadrecord()
+    {
+        instrumentationregistry& registry = getRegistry();
+        std::lock_guard<std::mutex> lock(registry.lock);
+        registry.retiredStats.merge(stats);
+        {
+            std::lock_guard<std::mutex> eventsLock(eventLock);
+            registry.retiredEvents.insert(registry.retiredEvents.end(), events.begin(), events.end());
+        }
+        if (prev)
+            prev->next = next;
+        else
+            registry.first = next;
+        if (next)
+            next->prev = prev;
+    }
+
+    static void mergeCounters(statcounter* counters, const statcounter* other, uint32 count)
+    {
+        for (uint32 i = 0; i < count; ++i)
+            counters[i].add(other[i].get());
+    }
+
+    void hashtablestats::merge(const hashtablestats& other)
+    {
+        probes.add(other.probes.get());
+        misses.add(other.misses.get());
+        probedGroups.add(other.probedGroups.get());
+        maxProbedGroups.setMax(other.maxProbedGroups.get());
+        mergeCounters(probeHistogram, other.probeHistogram, histogramSize);
+        inserts.add(other.inserts.get());
+        erases.add(other.erases.get());
+        rehashes.add(other.rehashes.get());
+        rebuilds.add(other.rebuilds.get());
+        migratedSlots.add(other.migratedSlots.get());
+    }
+
+    void arraystats::merge(const arraystats& other)
+    {
+        regrowths.add(other.regrowths.get());
+        relocations.add(other.relocations.get());
+        bytesMoved.add(other.bytesMoved.get());
+    }
+
+    void stringstats::merge(const stringstats& other)
+    {
+        spills.add(other.spills.get());
+        reallocations.add(other.reallocations.get());
+        bytesMoved.add(other.bytesMoved.get());
+    }
+
+    void instrumentationstats::merge(const instrumentationstats& other)
+    {
+        hashtable.merge(other.hashtable);
+        array.merge(other.array);
+        string.merge(other.string);
+    }
+
+    void instrumentationstats::reset()
+    {
+        hashtable.reset();
+        array.reset();
+        string.reset();
+    }
+
+    instrumentationstats& instrumentation::getThreadStats()
+    {
+        return getThreadRecord().stats;
+    }
+
+    instrumentationstats instrumentation::getTotals()
+    {
+        instrumentationregistry& registry = getRegistry();
+        std::lock_guard<std::mutex> lock(registry.lock);
+        instrumentationstats totals = registry.retiredStats;
+        for (threadrecord* record = registry.first; record; record = record->next)
+            totals.merge(record->stats);
+        return totals;
+    }
+
+    void instrumentation::reset()
+    {
+        instrumentationregistry& registry = getRegistry();
+        std::lock_guard<std::mutex> lock(registry.lock);
+        registry.retiredStats.reset();
+        for (threadrecord* record = registry.first; record; record = record->next)
+            record->stats.reset();
+    }
+
+    std::atomic<bool> tracer::capturing{ false };
+
+    void tracer::begin()
+    {
+        getTimestamp();
+        capturing.store(true, std::memory_order_relaxed);
+    }
+
+    void tracer::end()
+    {
+        capturing.store(false, std::memory_order_relaxed);
+    }
+
+    uint64 tracer::getTimestamp()
+    {
+        static const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+        return static_cast<uint64>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count());
+    }
+
+    void tracer::addEvent(const char* name, uint64 start, uint64 duration)
+    {
+        threadrecord& record = getThreadRecord();
+        std::lock_guard<std::mutex> lock(record.eventLock);
+        record.events.push_back({ name, start, duration, record.threadId });
+    }
+
+    uint32 tracer::getEventCount()
+    {
+        instrumentationregistry& registry = getRegistry();
+        std::lock_guard<std::mutex> lock(registry.lock);
+        size_t count = registry.retiredEvents.size();
+        for (threadrecord* record = registry.first; record; record = record->next)
+        {
+            std::lock_guard<std::mutex> eventsLock(record->eventLock);
+            count += record->events.size();
+        }
+        return static_cast<uint32>(count);
+    }
+
+    void tracer::clear()
+    {
+        instrumentationregistry& registry = getRegistry();
+        std::lock_guard<std::mutex> lock(registry.lock);
+        registry.retiredEvents.clear();
+        for (threadrecord* record = registry.first; record; record = record->next)
+        {
+            std::lock_guard<std::mutex> eventsLock(record->eventLock);
+            record->events.clear();
+        }
+    }
+
+    static void writeEvents(FILE* file, const std::vector<traceevent>& events, bool& first)
+    {
+        for (const traceevent& event : events)
+        {
+            // complete events, timestamps in microseconds
+            fprintf(file, "%s\n    {\"name\": \"%s\", \"cat\": \"coda\", \"ph\": \"X\", \"ts\": %.3f, \"dur\": %.3f, \"pid\": 1, \"tid\": %u}",
+                first ? "" : ",", event.name, static_cast<double>(event.start) / 1000.0, static_cast<double>(event.duration) / 1000.0, event.threadId);
+            first = false;
+        }
+    }
+
+    bool tracer::writeJson(const char* path)
+    {
+        FILE* file = fopen(path, "w");
+        if (!file)
+            return false;
+
+        fprintf(file, "{\"traceEvents\": [");
+        bool first = true;
+        {
+            instrumentationregistry& registry = getRegistry();
+            std::lock_guard<std::mutex> lock(registry.lock);
+            writeEvents(file, registry.retiredEvents, first);
+            for (threadrecord* record = registry.first; record; record = record->next)
+            {
+                std::lock_guard<std::mutex> eventsLock(record->eventLock);
+                writeEvents(file, record->events, first);
+            }
+        }
+        fprintf(file, "\n], \"displayTimeUnit\": \"ns\"}\n");
+        return fclose(file) == 0;
+    }
+}
@@ -0,0 +1,187 @@
+#pragma once
+
+#include "common.h"
+#include <atomic>
+
+// Container instrumentation and trace zones, 0 compiles every hook out. Set it the same way for
+// every translation unit, the CPPCODA_INSTRUMENTATION cmake option does it for the library users.
+#ifndef CODA_INSTRUMENTATION
+#define CODA_INSTRUMENTATION 0
+#endif
+
+#define CODA_INSTRUMENTATION_CONCAT_(a, b) a##b
+#define CODA_INSTRUMENTATION_CONCAT(a, b) CODA_INSTRUMENTATION_CONCAT_(a, b)
+
+#if CODA_INSTRUMENTATION
+// Statement only compiled in instrumented builds
+#define coda_instrument(x) x
+// Times the rest of the scope into the trace capture, name must be a string literal
+#define CODA_TRACE_ZONE(name) coda::tracezone CODA_INSTRUMENTATION_CONCAT(codaTraceZone, __COUNTER__)(name)
+#else
+#define coda_instrument(x) coda_dummy_macro
+#define CODA_TRACE_ZONE(name) coda_dummy_macro
+#endif
+
+namespace coda
+{
+    /**
+     * Counter with a single writer. Updates are a relaxed load and store, as cheap as a plain
+     * integer, and other threads can read it at any time, concurrent writers may lose counts.
+     */
+    class statcounter
+    {
+    public:
+        statcounter() = default;
+        statcounter(const statcounter& other) : value(other.get()) {}
+        statcounter& operator=(const statcounter& other) { set(other.get()); return *this; }
+
+        void add(uint64 n = 1) { set(get() + n); }
+        void setMax(uint64 n) { if (n > get()) set(n); }
+        void set(uint64 n) { value.store(n, std::memory_order_relaxed); }
+        uint64 get() const { return value.load(std::memory_order_relaxed); }
+
+    private:
+        std::atomic<uint64> value{ 0 };
+    };
+
+    struct hashtablestats
+    {
+        // probes walking [2^i, 2^(i+1)) groups land in bucket i
+        static constexpr uint32 histogramSize = 8;
+
+        // index probes, a lookup during a rehash may probe both indices
+        statcounter probes;
+        statcounter misses;
+        // control byte groups loaded, 16 slots or 32 with AVX2
+        statcounter probedGroups;
+        statcounter maxProbedGroups;
+        statcounter probeHistogram[histogramSize];
+        statcounter inserts;
+        statcounter erases;
+        statcounter rehashes;
+        // index rebuilt in place to drop tombstones
+        statcounter rebuilds;
+        // items moved from the old index to the new one
+        statcounter migratedSlots;
+
+        void recordProbe(uint64 groups, bool hit)
+        {
+            probes.add();
+            if (!hit)
+                misses.add();
+            probedGroups.add(groups);
+            maxProbedGroups.setMax(groups);
+            uint32 bucket = bitScanReverse(groups);
+            probeHistogram[bucket < histogramSize ? bucket : histogramSize - 1].add();
+        }
+
+        void merge(const hashtablestats& other);
+        void reset() { *this = hashtablestats(); }
+    };
+
+    struct arraystats
+    {
+        // capacity increases made by the array itself when full
+        statcounter regrowths;
+        // storage changes, regrowths included
+        statcounter relocations;
+        // elements moved or reallocated along with the storage, in bytes
+        statcounter bytesMoved;
+
+        void recordRelocation(uint64 bytes)
+        {
+            relocations.add();
+            bytesMoved.add(bytes);
+        }
+
+        void merge(const arraystats& other);
+        void reset() { *this = arraystats(); }
+    };
+
+    struct stringstats
+    {
+        // inline strings moved to the heap
+        statcounter spills;
+        statcounter reallocations;
+        statcounter bytesMoved;
+
+        void merge(const stringstats& other);
+        void reset() { *this = stringstats(); }
+    };
+
+    struct instrumentationstats
+    {
+        hashtablestats hashtable;
+        arraystats array;
+        stringstats string;
+
+        void merge(const instrumentationstats& other);
+        void reset();
+    };
+
+    /**
+     * Global registry of the container stats. Every thread records into its own block, registered
+     * on first use and folded into the totals when the thread exits, so containers never contend.
+     * Strings keep their 24 byte layout and only report here.
+     */
+    class instrumentation
+    {
+    public:
+        // Stats of the calling thread
+        static instrumentationstats& getThreadStats();
+        // Sum of every thread, live and finished
+        static instrumentationstats getTotals();
+        static void reset();
+    };
+
+    // Calls function(arraystats&) on the stats of an array and the thread ones
+    template <typename Function>
+    void recordArrayStats(arraystats& stats, Function function)
+    {
+        function(stats);
+        function(instrumentation::getThreadStats().array);
+    }
+
+    /**
+     * Chrome trace capture (chrome://tracing, ui.perfetto.dev). Zones are only recorded between
+     * begin and end, each thread buffers its own events.
+     */
+    class tracer
+    {
+    public:
+        static void begin();
+        static void end();
+        static bool isCapturing() { return capturing.load(std::memory_order_relaxed); }
+
+        // Nanoseconds since the first call
+        static uint64 getTimestamp();
+        static void addEvent(const char* name, uint64 start, uint64 duration);
+        static uint32 getEventCount();
+        static void clear();
+        // Writes the captured events as trace event JSON, false if the file can't be written
+        static bool writeJson(const char* path);
+
+    private:
+        static std::atomic<bool> capturing;
+    };
+
+    // Scoped zone, see CODA_TRACE_ZONE
+    class tracezone
+    {
+    public:
+        explicit tracezone(const char* _name) : name(_name), active(tracer::isCapturing()), start(active ? tracer::getTimestamp() : 0) {}
+        ~tracezone()
+        {
+            if (active)
+                tracer::addEvent(name, start, tracer::getTimestamp() - start);
+        }
+
+        tracezone(const tracezone&) = delete;
+        tracezone& operator=(const tracezone&) = delete;
+
+    private:
+        const char* name;
+        bool active;
+        uint64 start;
+    };
+}
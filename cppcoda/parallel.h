@@ -0,0 +1,199 @@
+#pragma once
+
+#include "common.h"
+#include "dynarray.h"
+#include "span.h"
+#include "threadpool.h"
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <utility>
+
+namespace coda
+{
+    /**
+     * Data parallel algorithms over index ranges and spans (dynarray::getSpan, starray::getSpan...),
+     * run in a threadpool, the default one unless given. Ranges are split in halves down to the
+     * grain size, the thread splitting keeps one half and queues the other so idle workers steal
+     * the biggest pieces left. A grain size of 0 picks one giving each thread a few pieces.
+     * Functions must not throw.
+     */
+    namespace parallel
+    {
+        // Pieces per thread with the automatic grain size, extra ones balance uneven pieces
+        static constexpr uint32 piecesPerThread = 4;
+
+        inline uint32 getGrainSize(uint32 count, uint32 grainSize, const threadpool& pool)
+        {
+            if (grainSize)
+                return grainSize;
+            uint32 pieces = pool.getConcurrency() * piecesPerThread;
+            uint32 automatic = count / pieces + (count % pieces != 0);
+            return automatic ? automatic : 1;
+        }
+
+        // Out of line so the piece loop gets its own registers, inlined in big callers GCC may keep its accumulator in memory
+        template <typename R, typename T, typename ReduceFunction>
+        CODA_NOINLINE R reducePiece(const ReduceFunction& function, span<T> piece)
+        {
+            return function(piece);
+        }
+
+        template <typename Function>
+        void splitRange(taskgroup& group, uint32 first, uint32 last, uint32 grainSize, const Function& function)
+        {
+            while (last - first > grainSize)
+            {
+                uint32 middle = first + (last - first) / 2;
+                group.run([&group, middle, last, grainSize, &function]() { splitRange(group, middle, last, grainSize, function); });
+                last = middle;
+            }
+            function(first, last);
+        }
+    }
+
+    // Calls function(first, last) on pieces of [first, last) in parallel
+    template <typename Function>
+    void parallelFor(uint32 first, uint32 last, Function function, uint32 grainSize = 0, threadpool& pool = threadpool::getDefault())
+    {
+        coda_assert(first <= last);
+        grainSize = parallel::getGrainSize(last - first, grainSize, pool);
+        if (last - first <= grainSize)
+        {
+            if (first != last)
+                function(first, last);
+            return;
+        }
+        taskgroup group(pool);
+        parallel::splitRange(group, first, last, grainSize, function);
+        group.wait();
+    }
+
+    // Calls function(span<T>) on pieces of values in parallel
+    template <typename T, typename Function>
+    void parallelFor(span<T> values, Function function, uint32 grainSize = 0, threadpool& pool = threadpool::getDefault())
+    {
+        parallelFor(0, values.getSize(), [values, &function](uint32 first, uint32 last) { function(span<T>(values.getData() + first, last - first)); },
+            grainSize, pool);
+    }
+
+    /**
+     * Reduces pieces of values with reducePiece(span<T>) -> R in parallel and merges the partial
+     * results with combine(R, R) -> R, in the order of the pieces. identity is the result of an
+     * empty span. R must be default constructible.
+     */
+    template <typename T, typename R, typename ReduceFunction, typename CombineFunction>
+    R parallelReduce(span<T> values, R identity, ReduceFunction reducePiece, CombineFunction combine, uint32 grainSize = 0,
+        threadpool& pool = threadpool::getDefault())
+    {
+        const uint32 count = values.getSize();
+        grainSize = parallel::getGrainSize(count, grainSize, pool);
+        const uint32 pieceCount = count / grainSize + (count % grainSize != 0);
+        if (!count)
+            return identity;
+        if (pieceCount == 1)
+            return parallel::reducePiece<R>(reducePiece, values);
+
+        dynarray<R> partials;
+        partials.resize(pieceCount);
+        parallelFor(0, pieceCount, [&](uint32 firstPiece, uint32 lastPiece)
+            {
+                for (uint32 i = firstPiece; i < lastPiece; ++i)
+                    partials[i] = parallel::reducePiece<R>(reducePiece, values.getSubspan(i * grainSize, grainSize));
+            }, 1, pool);
+
+        R result = std::move(partials[0]);
+        for (uint32 i = 1; i < pieceCount; ++i)
+            result = combine(std::move(result), std::move(partials[i]));
+        return result;
+    }
+
+    namespace parallel
+    {
+        // Merges the sorted [a, a + countA) and [b, b + countB) into out, splitting big merges around the middle of the longest
+        template <typename T, typename Compare>
+        void merge(taskgroup& group, T* a, uint32 countA, T* b, uint32 countB, T* out, uint32 grainSize, const Compare& compare)
+        {
+            while (countA + countB > grainSize)
+            {
+                if (countA < countB)
+                {
+                    std::swap(a, b);
+                    std::swap(countA, countB);
+                }
+                uint32 middleA = countA / 2;
+                uint32 middleB = static_cast<uint32>(std::lower_bound(b, b + countB, a[middleA], compare) - b);
+                out[middleA + middleB] = std::move(a[middleA]);
+                T* restA = a + middleA + 1;
+                T* restB = b + middleB;
+                T* restOut = out + middleA + middleB + 1;
+                uint32 restCountA = countA - middleA - 1;
+                uint32 restCountB = countB - middleB;
+                group.run([&group, restA, restCountA, restB, restCountB, restOut, grainSize, &compare]()
+                    {
+                        merge(group, restA, restCountA, restB, restCountB, restOut, grainSize, compare);
+                    });
+                countA = middleA;
+                countB = middleB;
+            }
+            std::merge(std::make_move_iterator(a), std::make_move_iterator(a + countA), std::make_move_iterator(b),
+                std::make_move_iterator(b + countB), out, compare);
+        }
+
+        /**
+         * Merge sort alternating between data and buffer: sorts [data, data + count) into buffer
+         * when toBuffer is set, in place otherwise. Pieces up to grainSize go to std::sort.
+         */
+        template <typename T, typename Compare>
+        void sort(T* data, T* buffer, uint32 count, bool toBuffer, uint32 grainSize, threadpool& pool, const Compare& compare)
+        {
+            if (count <= grainSize)
+            {
+                std::sort(data, data + count, compare);
+                if (toBuffer)
+                    std::move(data, data + count, buffer);
+                return;
+            }
+
+            // the halves end in the other array, merged back into the target
+            const uint32 half = count / 2;
+            {
+                taskgroup group(pool);
+                group.run([=, &pool, &compare]() { sort(data, buffer, half, !toBuffer, grainSize, pool, compare); });
+                sort(data + half, buffer + half, count - half, !toBuffer, grainSize, pool, compare);
+                group.wait();
+            }
+            T* from = toBuffer ? data : buffer;
+            T* to = toBuffer ? buffer : data;
+            taskgroup group(pool);
+            merge(group, from, half, from + half, count - half, to, grainSize, compare);
+            group.wait();
+        }
+    }
+
+    /**
+     * Sorts values in parallel with a merge sort over std::sort pieces, not stable. Needs a buffer
+     * of default constructed T as big as values.
+     */
+    template <typename T, typename Compare = std::less<T>>
+    void parallelSort(span<T> values, Compare compare = Compare(), uint32 grainSize = 0, threadpool& pool = threadpool::getDefault())
+    {
+        const uint32 count = values.getSize();
+        // smaller automatic pieces sort faster serially than they merge
+        static constexpr uint32 minGrainSize = 2048;
+        if (!grainSize)
+        {
+            grainSize = parallel::getGrainSize(count, 0, pool);
+            if (grainSize < minGrainSize)
+                grainSize = minGrainSize;
+        }
+        if (count <= grainSize)
+        {
+            std::sort(values.begin(), values.end(), compare);
+            return;
+        }
+        dynarray<T> buffer;
+        buffer.resize(count);
+        parallel::sort(values.getData(), buffer.getData(), count, false, grainSize, pool, compare);
+    }
+}
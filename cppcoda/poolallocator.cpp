@@ -0,0 +1,270 @@
+#include "poolallocator.h"
+#include <cstring>
+#include <mutex>
+
+namespace coda
+{
+    static constexpr size_t g_slabSize = 64 * 1024;
+    static constexpr uint32 g_largeClass = 0xffffffff;
+    // blocks moved between a thread cache and the depot at once
+    static constexpr uint32 g_batchSize = 32;
+    static constexpr uint32 g_maxCachedBlocks = g_batchSize * 2;
+
+    static constexpr size_t g_classSizes[poolallocator::sizeClassCount] = { 16, 32, 48, 64, 80, 96, 112, 128, 192, 256, 320, 384, 448, 512 };
+
+    // Precedes every block, keeps the 16 byte alignment of the payload
+    struct poolheader
+    {
+        uint32 sizeClass;
+        uint32 padding;
+        size_t size;
+    };
+    static_assert(sizeof(poolheader) == 16, "pool header breaks the alignment");
+
+    // Released blocks link through their payload
+    struct freeblock
+    {
+        freeblock* next;
+    };
+
+    static inline poolheader* getHeader(const void* p)
+    {
+        return reinterpret_cast<poolheader*>(const_cast<byte*>(static_cast<const byte*>(p)) - sizeof(poolheader));
+    }
+
+    static inline freeblock* toFreeBlock(poolheader* header)
+    {
+        return reinterpret_cast<freeblock*>(header + 1);
+    }
+
+    // Unlinks up to maxCount blocks from head into out, returns the last one
+    static inline freeblock* popBlocks(freeblock*& head, uint32& count, freeblock*& out, uint32 maxCount)
+    {
+        uint32 n = 0;
+        freeblock* first = head;
+        freeblock* last = nullptr;
+        while (head && n < maxCount)
+        {
+            last = head;
+            head = head->next;
+            ++n;
+        }
+        if (last)
+            last->next = nullptr;
+        count -= n;
+        out = first;
+        return last;
+    }
+
+    // Shared pools, one free list and lock per size class
+    class pooldepot
+    {
+    public:
+        // Moves up to count blocks to list, carving a new slab if needed
+        uint32 takeBatch(uint32 sizeClass, freeblock*& list, uint32 count)
+        {
+            sizeclasspool& pool = pools[sizeClass];
+            std::lock_guard<std::mutex> lock(pool.lock);
+            if (!pool.head)
+                carveSlab(sizeClass, pool);
+            uint32 before = pool.count;
+            freeblock* batch;
+            freeblock* last = popBlocks(pool.head, pool.count, batch, count);
+            last->next = list;
+            list = batch;
+            return before - pool.count;
+        }
+
+        void giveBatch(uint32 sizeClass, freeblock* first, freeblock* last, uint32 count)
+        {
+            sizeclasspool& pool = pools[sizeClass];
+            std::lock_guard<std::mutex> lock(pool.lock);
+            last->next = pool.head;
+            pool.head = first;
+            pool.count += count;
+        }
+
+        static pooldepot& get()
+        {
+            // never destroyed, thread caches may flush into it during shutdown
+            static pooldepot* depot = new pooldepot();
+            return *depot;
+        }
+
+    private:
+        struct sizeclasspool
+        {
+            std::mutex lock;
+            freeblock* head = nullptr;
+            uint32 count = 0;
+        };
+
+        void carveSlab(uint32 sizeClass, sizeclasspool& pool)
+        {
+            const size_t stride = sizeof(poolheader) + g_classSizes[sizeClass];
+            const uint32 blockCount = static_cast<uint32>(g_slabSize / stride);
+            byte* slab = static_cast<byte*>(baseallocator::allocate(g_slabSize));
+            coda_assert(slab);
+            // link the blocks in address order
+            for (uint32 i = blockCount; i > 0; --i)
+            {
+                poolheader* header = reinterpret_cast<poolheader*>(slab + (i - 1) * stride);
+                header->sizeClass = sizeClass;
+                freeblock* block = toFreeBlock(header);
+                block->next = pool.head;
+                pool.head = block;
+            }
+            pool.count += blockCount;
+        }
+
+    private:
+        sizeclasspool pools[poolallocator::sizeClassCount];
+    };
+
+#if CODA_POOL_THREAD_CACHE
+    struct poolthreadcache
+    {
+        struct blocklist
+        {
+            freeblock* head = nullptr;
+            uint32 count = 0;
+        };
+
+        ~poolthreadcache()
+        {
+            for (uint32 i = 0; i < poolallocator::sizeClassCount; ++i)
+                flush(i, lists[i].count);
+        }
+
+        void* allocate(uint32 sizeClass)
+        {
+            blocklist& list = lists[sizeClass];
+            if (!list.head)
+                list.count += pooldepot::get().takeBatch(sizeClass, list.head, g_batchSize);
+            freeblock* block = list.head;
+            list.head = block->next;
+            --list.count;
+            return block;
+        }
+
+        void release(uint32 sizeClass, freeblock* block)
+        {
+            blocklist& list = lists[sizeClass];
+            block->next = list.head;
+            list.head = block;
+            if (++list.count > g_maxCachedBlocks)
+                flush(sizeClass, g_batchSize);
+        }
+
+        void flush(uint32 sizeClass, uint32 count)
+        {
+            blocklist& list = lists[sizeClass];
+            if (!count || !list.head)
+                return;
+            uint32 before = list.count;
+            freeblock* batch;
+            freeblock* last = popBlocks(list.head, list.count, batch, count);
+            pooldepot::get().giveBatch(sizeClass, batch, last, before - list.count);
+        }
+
+        blocklist lists[poolallocator::sizeClassCount];
+    };
+
+    static thread_local poolthreadcache t_poolCache;
+#endif
+
+    static void* allocatePooled(uint32 sizeClass)
+    {
+#if CODA_POOL_THREAD_CACHE
+        return t_poolCache.allocate(sizeClass);
+#else
+        freeblock* block = nullptr;
+        pooldepot::get().takeBatch(sizeClass, block, 1);
+        return block;
+#endif
+    }
+
+    static void releasePooled(uint32 sizeClass, void* p)
+    {
+        freeblock* block = static_cast<freeblock*>(p);
+#if CODA_POOL_THREAD_CACHE
+        t_poolCache.release(sizeClass, block);
+#else
+        pooldepot::get().giveBatch(sizeClass, block, block, 1);
+#endif
+    }
+
+    uint32 poolallocator::getSizeClass(size_t size)
+    {
+        if (size <= 128)
+            return size ? static_cast<uint32>((size - 1) >> 4) : 0;
+        if (size <= maxPooledSize)
+            return static_cast<uint32>(8 + ((size - 129) >> 6));
+        return g_largeClass;
+    }
+
+    size_t poolallocator::getClassSize(uint32 sizeClass)
+    {
+        coda_assert(sizeClass < sizeClassCount);
+        return g_classSizes[sizeClass];
+    }
+
+    size_t poolallocator::getBlockSize(const void* p)
+    {
+        const poolheader* header = getHeader(p);
+        return header->sizeClass == g_largeClass ? header->size : g_classSizes[header->sizeClass];
+    }
+
+    void* poolallocator::allocate(size_t size)
+    {
+        uint32 sizeClass = getSizeClass(size);
+        if (sizeClass != g_largeClass)
+            return allocatePooled(sizeClass);
+
+        poolheader* header = static_cast<poolheader*>(baseallocator::allocate(sizeof(poolheader) + size));
+        if (!header)
+            return nullptr;
+        header->sizeClass = g_largeClass;
+        header->size = size;
+        return header + 1;
+    }
+
+    void* poolallocator::reallocate(void* p, size_t size)
+    {
+        if (!p)
+            return allocate(size);
+
+        poolheader* header = getHeader(p);
+        if (header->sizeClass == g_largeClass)
+        {
+            // large blocks stay in malloc even when shrinking below maxPooledSize
+            header = static_cast<poolheader*>(baseallocator::reallocate(header, sizeof(poolheader) + size));
+            if (!header)
+                return nullptr;
+            header->size = size;
+            return header + 1;
+        }
+
+        size_t blockSize = g_classSizes[header->sizeClass];
+        if (size <= blockSize)
+            return p;
+        void* newBlock = allocate(size);
+        if (newBlock)
+        {
+            memcpy(newBlock, p, blockSize);
+            releasePooled(header->sizeClass, p);
+        }
+        return newBlock;
+    }
+
+    void poolallocator::release(void* p)
+    {
+        if (!p)
+            return;
+        poolheader* header = getHeader(p);
+        if (header->sizeClass == g_largeClass)
+            baseallocator::release(header);
+        else
+            releasePooled(header->sizeClass, p);
+    }
+}
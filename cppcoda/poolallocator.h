@@ -0,0 +1,37 @@
+#pragma once
+
+#include "common.h"
+#include "allocator.h"
+
+// Per-thread caches in front of the shared pools, 0 makes every call lock its size class
+#ifndef CODA_POOL_THREAD_CACHE
+#define CODA_POOL_THREAD_CACHE 1
+#endif
+
+namespace coda
+{
+    /**
+     * AllocatorType policy for small blocks.
+     * Sizes up to maxPooledSize are rounded up to a size class. Each class carves 64KB slabs into
+     * fixed blocks and recycles released blocks through an intrusive free list, so allocating is a
+     * pop and releasing a push. Each thread keeps a few blocks per class and trades them in batches
+     * with the shared depot, which is only locked on refills and flushes. Bigger blocks go to malloc.
+     * Slab memory is reused but never given back to the system.
+     */
+    class poolallocator
+    {
+    public:
+        static constexpr size_t maxPooledSize = 512;
+        static constexpr uint32 sizeClassCount = 14;
+
+        static void* allocate(size_t size);
+        // Stays in place while the size fits in the block's size class
+        static void* reallocate(void* p, size_t size);
+        static void release(void* p);
+
+        static uint32 getSizeClass(size_t size);
+        static size_t getClassSize(uint32 sizeClass);
+        // Usable bytes of a block returned by allocate
+        static size_t getBlockSize(const void* p);
+    };
+}
@@ -0,0 +1,494 @@
+#include "simd.h"
+#include "cpu.h"
+
+namespace coda
+{
+    namespace simd
+    {
+        // Element wise operations of reduce
+        struct opadd
+        {
+            // integer sums wrap around
+            template <typename T>
+            static T apply(T a, T b)
+            {
+                if constexpr (std::is_integral<T>::value)
+                    return static_cast<T>(static_cast<typename std::make_unsigned<T>::type>(a) + static_cast<typename std::make_unsigned<T>::type>(b));
+                else
+                    return a + b;
+            }
+        };
+
+        struct opmin
+        {
+            template <typename T>
+            static T apply(T a, T b) { return b < a ? b : a; }
+        };
+
+        struct opmax
+        {
+            template <typename T>
+            static T apply(T a, T b) { return a < b ? b : a; }
+        };
+
+        /**
+         * Lanes of a vector register, the kernels are written against this interface:
+         * load/store/set, combine(op, a, b) for reduce, matchMask with a bit per equal lane and a
+         * counter vector adding one per equal lane. Scalar lanes are a single element wide.
+         */
+        template <typename T>
+        struct scalarlanes
+        {
+            typedef T type;
+            typedef T vec;
+            typedef uint32 countvec;
+            static constexpr uint32 width = 1;
+
+            static vec load(const T* p) { return *p; }
+            static void store(T* p, vec v) { *p = v; }
+            static vec set(T value) { return value; }
+            template <typename Op>
+            static vec combine(Op, vec a, vec b) { return Op::apply(a, b); }
+            static uint32 matchMask(vec a, vec b) { return a == b; }
+            static countvec countZero() { return 0; }
+            static countvec countMatches(countvec counter, vec a, vec b) { return counter + (a == b); }
+            static uint32 getCount(countvec counter) { return counter; }
+            static vec multiplyAdd(vec a, vec scale, vec offset) { return a * scale + offset; }
+        };
+
+#ifdef CODA_X86_64
+        template <typename T>
+        struct sse2lanes;
+
+        template <>
+        struct sse2lanes<float>
+        {
+            typedef float type;
+            typedef __m128 vec;
+            typedef __m128i countvec;
+            static constexpr uint32 width = 4;
+
+            static vec load(const float* p) { return _mm_loadu_ps(p); }
+            static void store(float* p, vec v) { _mm_storeu_ps(p, v); }
+            static vec set(float value) { return _mm_set1_ps(value); }
+            static vec combine(opadd, vec a, vec b) { return _mm_add_ps(a, b); }
+            static vec combine(opmin, vec a, vec b) { return _mm_min_ps(a, b); }
+            static vec combine(opmax, vec a, vec b) { return _mm_max_ps(a, b); }
+            static uint32 matchMask(vec a, vec b) { return static_cast<uint32>(_mm_movemask_ps(_mm_cmpeq_ps(a, b))); }
+            static countvec countZero() { return _mm_setzero_si128(); }
+            // equal lanes are all ones, -1
+            static countvec countMatches(countvec counter, vec a, vec b) { return _mm_sub_epi32(counter, _mm_castps_si128(_mm_cmpeq_ps(a, b))); }
+            static uint32 getCount(countvec counter) { return sumCounter(counter); }
+            static vec multiplyAdd(vec a, vec scale, vec offset) { return _mm_add_ps(_mm_mul_ps(a, scale), offset); }
+
+            static uint32 sumCounter(countvec counter)
+            {
+                alignas(16) uint32 lanes[4];
+                _mm_store_si128(reinterpret_cast<__m128i*>(lanes), counter);
+                return lanes[0] + lanes[1] + lanes[2] + lanes[3];
+            }
+        };
+
+        // SSE2 has no 32 bit integer min/max, they compare and select. Unsigned values are compared
+        // with their sign bit flipped.
+        template <typename T>
+        struct sse2integerlanes
+        {
+            typedef T type;
+            typedef __m128i vec;
+            typedef __m128i countvec;
+            static constexpr uint32 width = 4;
+
+            static vec load(const T* p) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); }
+            static void store(T* p, vec v) { _mm_storeu_si128(reinterpret_cast<__m128i*>(p), v); }
+            static vec set(T value) { return _mm_set1_epi32(static_cast<int32>(value)); }
+            static vec combine(opadd, vec a, vec b) { return _mm_add_epi32(a, b); }
+            static vec combine(opmin, vec a, vec b) { return select(greater(a, b), b, a); }
+            static vec combine(opmax, vec a, vec b) { return select(greater(a, b), a, b); }
+            static uint32 matchMask(vec a, vec b) { return static_cast<uint32>(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(a, b)))); }
+            static countvec countZero() { return _mm_setzero_si128(); }
+            static countvec countMatches(countvec counter, vec a, vec b) { return _mm_sub_epi32(counter, _mm_cmpeq_epi32(a, b)); }
+            static uint32 getCount(countvec counter) { return sse2lanes<float>::sumCounter(counter); }
+
+            static vec greater(vec a, vec b)
+            {
+                if constexpr (std::is_unsigned<T>::value)
+                {
+                    const __m128i sign = _mm_set1_epi32(static_cast<int32>(0x80000000u));
+                    return _mm_cmpgt_epi32(_mm_xor_si128(a, sign), _mm_xor_si128(b, sign));
+                }
+                else
+                {
+                    return _mm_cmpgt_epi32(a, b);
+                }
+            }
+
+            // mask ? a : b
+            static vec select(vec mask, vec a, vec b) { return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b)); }
+        };
+
+        template <>
+        struct sse2lanes<int32> : sse2integerlanes<int32> {};
+        template <>
+        struct sse2lanes<uint32> : sse2integerlanes<uint32> {};
+
+        template <typename T>
+        struct avx2lanes;
+
+        template <>
+        struct avx2lanes<float>
+        {
+            typedef float type;
+            typedef __m256 vec;
+            typedef __m256i countvec;
+            static constexpr uint32 width = 8;
+
+            CODA_TARGET_AVX2 static vec load(const float* p) { return _mm256_loadu_ps(p); }
+            CODA_TARGET_AVX2 static void store(float* p, vec v) { _mm256_storeu_ps(p, v); }
+            CODA_TARGET_AVX2 static vec set(float value) { return _mm256_set1_ps(value); }
+            CODA_TARGET_AVX2 static vec combine(opadd, vec a, vec b) { return _mm256_add_ps(a, b); }
+            CODA_TARGET_AVX2 static vec combine(opmin, vec a, vec b) { return _mm256_min_ps(a, b); }
+            CODA_TARGET_AVX2 static vec combine(opmax, vec a, vec b) { return _mm256_max_ps(a, b); }
+            CODA_TARGET_AVX2 static uint32 matchMask(vec a, vec b) { return static_cast<uint32>(_mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_EQ_OQ))); }
+            CODA_TARGET_AVX2 static countvec countZero() { return _mm256_setzero_si256(); }
+            CODA_TARGET_AVX2 static countvec countMatches(countvec counter, vec a, vec b) { return _mm256_sub_epi32(counter, _mm256_castps_si256(_mm256_cmp_ps(a, b, _CMP_EQ_OQ))); }
+            CODA_TARGET_AVX2 static uint32 getCount(countvec counter) { return sumCounter(counter); }
+            CODA_TARGET_AVX2 static vec multiplyAdd(vec a, vec scale, vec offset) { return _mm256_add_ps(_mm256_mul_ps(a, scale), offset); }
+
+            CODA_TARGET_AVX2 static uint32 sumCounter(countvec counter)
+            {
+                __m128i half = _mm_add_epi32(_mm256_castsi256_si128(counter), _mm256_extracti128_si256(counter, 1));
+                return sse2lanes<float>::sumCounter(half);
+            }
+        };
+
+        template <typename T>
+        struct avx2integerlanes
+        {
+            typedef T type;
+            typedef __m256i vec;
+            typedef __m256i countvec;
+            static constexpr uint32 width = 8;
+
+            CODA_TARGET_AVX2 static vec load(const T* p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); }
+            CODA_TARGET_AVX2 static void store(T* p, vec v) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), v); }
+            CODA_TARGET_AVX2 static vec set(T value) { return _mm256_set1_epi32(static_cast<int32>(value)); }
+            CODA_TARGET_AVX2 static vec combine(opadd, vec a, vec b) { return _mm256_add_epi32(a, b); }
+            CODA_TARGET_AVX2 static vec combine(opmin, vec a, vec b)
+            {
+                if constexpr (std::is_unsigned<T>::value)
+                    return _mm256_min_epu32(a, b);
+                else
+                    return _mm256_min_epi32(a, b);
+            }
+            CODA_TARGET_AVX2 static vec combine(opmax, vec a, vec b)
+            {
+                if constexpr (std::is_unsigned<T>::value)
+                    return _mm256_max_epu32(a, b);
+                else
+                    return _mm256_max_epi32(a, b);
+            }
+            CODA_TARGET_AVX2 static uint32 matchMask(vec a, vec b) { return static_cast<uint32>(_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(a, b)))); }
+            CODA_TARGET_AVX2 static countvec countZero() { return _mm256_setzero_si256(); }
+            CODA_TARGET_AVX2 static countvec countMatches(countvec counter, vec a, vec b) { return _mm256_sub_epi32(counter, _mm256_cmpeq_epi32(a, b)); }
+            CODA_TARGET_AVX2 static uint32 getCount(countvec counter) { return avx2lanes<float>::sumCounter(counter); }
+        };
+
+        template <>
+        struct avx2lanes<int32> : avx2integerlanes<int32> {};
+        template <>
+        struct avx2lanes<uint32> : avx2integerlanes<uint32> {};
+#endif
+
+        // Four independent accumulators hide the latency of the vector op
+        template <typename Op, typename Lanes, typename T>
+        static T reduce(Lanes, const T* data, uint32 size, T result)
+        {
+            typedef typename Lanes::vec vec;
+            constexpr uint32 width = Lanes::width;
+            uint32 i = 0;
+            if (size >= 4 * width)
+            {
+                vec a0 = Lanes::load(data);
+                vec a1 = Lanes::load(data + width);
+                vec a2 = Lanes::load(data + 2 * width);
+                vec a3 = Lanes::load(data + 3 * width);
+                for (i = 4 * width; i + 4 * width <= size; i += 4 * width)
+                {
+                    a0 = Lanes::combine(Op(), a0, Lanes::load(data + i));
+                    a1 = Lanes::combine(Op(), a1, Lanes::load(data + i + width));
+                    a2 = Lanes::combine(Op(), a2, Lanes::load(data + i + 2 * width));
+                    a3 = Lanes::combine(Op(), a3, Lanes::load(data + i + 3 * width));
+                }
+                a0 = Lanes::combine(Op(), Lanes::combine(Op(), a0, a1), Lanes::combine(Op(), a2, a3));
+                T lanes[width];
+                Lanes::store(lanes, a0);
+                for (uint32 j = 0; j < width; ++j)
+                    result = Op::apply(result, lanes[j]);
+            }
+            for (; i < size; ++i)
+                result = Op::apply(result, data[i]);
+            return result;
+        }
+
+        // Single accumulator, GCC 12 at -O3 miscompiles the four accumulators one element wide
+        template <typename Op, typename T>
+        static T reduce(scalarlanes<T>, const T* data, uint32 size, T result)
+        {
+            for (uint32 i = 0; i < size; ++i)
+                result = Op::apply(result, data[i]);
+            return result;
+        }
+
+        template <typename Lanes, typename T>
+        static uint32 find(Lanes, const T* data, uint32 size, T value)
+        {
+            constexpr uint32 width = Lanes::width;
+            const typename Lanes::vec target = Lanes::set(value);
+            uint32 i = 0;
+            for (; i + width <= size; i += width)
+            {
+                uint32 mask = Lanes::matchMask(Lanes::load(data + i), target);
+                if (mask)
+                    return i + bitScanForward(mask);
+            }
+            for (; i < size; ++i)
+            {
+                if (data[i] == value)
+                    return i;
+            }
+            return invalidIndex;
+        }
+
+        template <typename Lanes, typename T>
+        static uint32 count(Lanes, const T* data, uint32 size, T value)
+        {
+            constexpr uint32 width = Lanes::width;
+            const typename Lanes::vec target = Lanes::set(value);
+            // two counters so consecutive compares don't wait on each other
+            typename Lanes::countvec counter0 = Lanes::countZero();
+            typename Lanes::countvec counter1 = Lanes::countZero();
+            uint32 i = 0;
+            for (; i + 2 * width <= size; i += 2 * width)
+            {
+                counter0 = Lanes::countMatches(counter0, Lanes::load(data + i), target);
+                counter1 = Lanes::countMatches(counter1, Lanes::load(data + i + width), target);
+            }
+            if (i + width <= size)
+            {
+                counter0 = Lanes::countMatches(counter0, Lanes::load(data + i), target);
+                i += width;
+            }
+            uint32 result = Lanes::getCount(counter0) + Lanes::getCount(counter1);
+            for (; i < size; ++i)
+                result += data[i] == value;
+            return result;
+        }
+
+        template <typename Lanes, typename T>
+        static void fill(Lanes, T* data, uint32 size, T value)
+        {
+            constexpr uint32 width = Lanes::width;
+            const typename Lanes::vec v = Lanes::set(value);
+            uint32 i = 0;
+            for (; i + width <= size; i += width)
+                Lanes::store(data + i, v);
+            for (; i < size; ++i)
+                data[i] = value;
+        }
+
+        template <typename Lanes>
+        static void multiplyAdd(Lanes, const float* src, float* dst, uint32 size, float scale, float offset)
+        {
+            constexpr uint32 width = Lanes::width;
+            const typename Lanes::vec scales = Lanes::set(scale);
+            const typename Lanes::vec offsets = Lanes::set(offset);
+            uint32 i = 0;
+            for (; i + width <= size; i += width)
+                Lanes::store(dst + i, Lanes::multiplyAdd(Lanes::load(src + i), scales, offsets));
+            for (; i < size; ++i)
+                dst[i] = src[i] * scale + offset;
+        }
+
+#ifdef CODA_X86_64
+        // Same kernels compiled for AVX2, GCC and Clang only inline the lanes into AVX2 functions
+        template <typename Op, typename T>
+        CODA_TARGET_AVX2 static T reduce(avx2lanes<T>, const T* data, uint32 size, T result)
+        {
+            typedef avx2lanes<T> Lanes;
+            typedef typename Lanes::vec vec;
+            constexpr uint32 width = Lanes::width;
+            uint32 i = 0;
+            if (size >= 4 * width)
+            {
+                vec a0 = Lanes::load(data);
+                vec a1 = Lanes::load(data + width);
+                vec a2 = Lanes::load(data + 2 * width);
+                vec a3 = Lanes::load(data + 3 * width);
+                for (i = 4 * width; i + 4 * width <= size; i += 4 * width)
+                {
+                    a0 = Lanes::combine(Op(), a0, Lanes::load(data + i));
+                    a1 = Lanes::combine(Op(), a1, Lanes::load(data + i + width));
+                    a2 = Lanes::combine(Op(), a2, Lanes::load(data + i + 2 * width));
+                    a3 = Lanes::combine(Op(), a3, Lanes::load(data + i + 3 * width));
+                }
+                a0 = Lanes::combine(Op(), Lanes::combine(Op(), a0, a1), Lanes::combine(Op(), a2, a3));
+                alignas(32) T lanes[width];
+                Lanes::store(lanes, a0);
+                for (uint32 j = 0; j < width; ++j)
+                    result = Op::apply(result, lanes[j]);
+            }
+            for (; i < size; ++i)
+                result = Op::apply(result, data[i]);
+            return result;
+        }
+
+        template <typename T>
+        CODA_TARGET_AVX2 static uint32 find(avx2lanes<T>, const T* data, uint32 size, T value)
+        {
+            typedef avx2lanes<T> Lanes;
+            constexpr uint32 width = Lanes::width;
+            const typename Lanes::vec target = Lanes::set(value);
+            uint32 i = 0;
+            for (; i + width <= size; i += width)
+            {
+                uint32 mask = Lanes::matchMask(Lanes::load(data + i), target);
+                if (mask)
+                    return i + bitScanForward(mask);
+            }
+            for (; i < size; ++i)
+            {
+                if (data[i] == value)
+                    return i;
+            }
+            return invalidIndex;
+        }
+
+        template <typename T>
+        CODA_TARGET_AVX2 static uint32 count(avx2lanes<T>, const T* data, uint32 size, T value)
+        {
+            typedef avx2lanes<T> Lanes;
+            constexpr uint32 width = Lanes::width;
+            const typename Lanes::vec target = Lanes::set(value);
+            // two counters so consecutive compares don't wait on each other
+            typename Lanes::countvec counter0 = Lanes::countZero();
+            typename Lanes::countvec counter1 = Lanes::countZero();
+            uint32 i = 0;
+            for (; i + 2 * width <= size; i += 2 * width)
+            {
+                counter0 = Lanes::countMatches(counter0, Lanes::load(data + i), target);
+                counter1 = Lanes::countMatches(counter1, Lanes::load(data + i + width), target);
+            }
+            if (i + width <= size)
+            {
+                counter0 = Lanes::countMatches(counter0, Lanes::load(data + i), target);
+                i += width;
+            }
+            uint32 result = Lanes::getCount(counter0) + Lanes::getCount(counter1);
+            for (; i < size; ++i)
+                result += data[i] == value;
+            return result;
+        }
+
+        template <typename T>
+        CODA_TARGET_AVX2 static void fill(avx2lanes<T>, T* data, uint32 size, T value)
+        {
+            typedef avx2lanes<T> Lanes;
+            constexpr uint32 width = Lanes::width;
+            const typename Lanes::vec v = Lanes::set(value);
+            uint32 i = 0;
+            for (; i + width <= size; i += width)
+                Lanes::store(data + i, v);
+            for (; i < size; ++i)
+                data[i] = value;
+        }
+
+        CODA_TARGET_AVX2 static void multiplyAdd(avx2lanes<float>, const float* src, float* dst, uint32 size, float scale, float offset)
+        {
+            typedef avx2lanes<float> Lanes;
+            constexpr uint32 width = Lanes::width;
+            const Lanes::vec scales = Lanes::set(scale);
+            const Lanes::vec offsets = Lanes::set(offset);
+            uint32 i = 0;
+            for (; i + width <= size; i += width)
+                Lanes::store(dst + i, Lanes::multiplyAdd(Lanes::load(src + i), scales, offsets));
+            for (; i < size; ++i)
+                dst[i] = src[i] * scale + offset;
+        }
+#endif
+
+        // Calls function with the lanes of the widest instruction set available
+        template <typename T, typename Function>
+        static auto dispatch(Function function)
+        {
+#ifdef CODA_X86_64
+            const cpufeatures& features = getCpuFeatures();
+            if (features.avx2)
+                return function(avx2lanes<T>());
+            if (features.sse2)
+                return function(sse2lanes<T>());
+#endif
+            return function(scalarlanes<T>());
+        }
+
+        template <typename Op, typename T>
+        static T reduce(span<const T> values, T initial)
+        {
+            return dispatch<T>([&](auto lanes) { return reduce<Op>(lanes, values.getData(), values.getSize(), initial); });
+        }
+
+        template <typename Op, typename T>
+        static T reduceNotEmpty(span<const T> values)
+        {
+            coda_assert(!values.isEmpty());
+            return reduce<Op>(values.getSubspan(1), values[0]);
+        }
+
+        template <typename T>
+        static uint32 findValue(span<const T> values, T value)
+        {
+            return dispatch<T>([&](auto lanes) { return find(lanes, values.getData(), values.getSize(), value); });
+        }
+
+        template <typename T>
+        static uint32 countValue(span<const T> values, T value)
+        {
+            return dispatch<T>([&](auto lanes) { return count(lanes, values.getData(), values.getSize(), value); });
+        }
+
+        template <typename T>
+        static void fillValue(span<T> values, T value)
+        {
+            dispatch<T>([&](auto lanes) { fill(lanes, values.getData(), values.getSize(), value); });
+        }
+
+        float sum(span<const float> values) { return reduce<opadd>(values, 0.f); }
+        int32 sum(span<const int32> values) { return reduce<opadd>(values, 0); }
+        uint32 sum(span<const uint32> values) { return reduce<opadd>(values, 0u); }
+
+        float minimum(span<const float> values) { return reduceNotEmpty<opmin>(values); }
+        int32 minimum(span<const int32> values) { return reduceNotEmpty<opmin>(values); }
+        uint32 minimum(span<const uint32> values) { return reduceNotEmpty<opmin>(values); }
+        float maximum(span<const float> values) { return reduceNotEmpty<opmax>(values); }
+        int32 maximum(span<const int32> values) { return reduceNotEmpty<opmax>(values); }
+        uint32 maximum(span<const uint32> values) { return reduceNotEmpty<opmax>(values); }
+
+        uint32 find(span<const float> values, float value) { return findValue(values, value); }
+        uint32 find(span<const int32> values, int32 value) { return findValue(values, value); }
+        uint32 find(span<const uint32> values, uint32 value) { return findValue(values, value); }
+
+        uint32 count(span<const float> values, float value) { return countValue(values, value); }
+        uint32 count(span<const int32> values, int32 value) { return countValue(values, value); }
+        uint32 count(span<const uint32> values, uint32 value) { return countValue(values, value); }
+
+        void fill(span<float> values, float value) { fillValue(values, value); }
+        void fill(span<int32> values, int32 value) { fillValue(values, value); }
+        void fill(span<uint32> values, uint32 value) { fillValue(values, value); }
+
+        void multiplyAdd(span<const float> src, span<float> dst, float scale, float offset)
+        {
+            coda_assert(dst.getSize() >= src.getSize());
+            dispatch<float>([&](auto lanes) { multiplyAdd(lanes, src.getData(), dst.getData(), src.getSize(), scale, offset); });
+        }
+    }
+}
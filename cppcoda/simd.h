@@ -0,0 +1,57 @@
+#pragma once
+
+#include "common.h"
+#include "simdfill.h"
+#include "span.h"
+
+namespace coda
+{
+    /**
+     * Bulk algorithms over spans of numbers. The float, int32 and uint32 versions run SSE2 or AVX2
+     * kernels picked at runtime from getCpuFeatures(), with a scalar fallback on other CPUs.
+     * Vector kernels add the elements in a different order than a plain loop, float sums may differ
+     * in the last bits. NaNs give unspecified results in minimum and maximum. fill lives in
+     * simdfill.h.
+     */
+    namespace simd
+    {
+        // Returned by find when no element matches
+        static constexpr uint32 invalidIndex = TypeLimit<uint32>::max();
+
+        // Integer sums wrap around like a plain loop
+        float sum(span<const float> values);
+        int32 sum(span<const int32> values);
+        uint32 sum(span<const uint32> values);
+
+        // values must not be empty
+        float minimum(span<const float> values);
+        int32 minimum(span<const int32> values);
+        uint32 minimum(span<const uint32> values);
+        float maximum(span<const float> values);
+        int32 maximum(span<const int32> values);
+        uint32 maximum(span<const uint32> values);
+
+        // Index of the first element equal to value, invalidIndex if there is none
+        uint32 find(span<const float> values, float value);
+        uint32 find(span<const int32> values, int32 value);
+        uint32 find(span<const uint32> values, uint32 value);
+
+        uint32 count(span<const float> values, float value);
+        uint32 count(span<const int32> values, int32 value);
+        uint32 count(span<const uint32> values, uint32 value);
+
+        // dst[i] = src[i] * scale + offset, dst may be src itself
+        void multiplyAdd(span<const float> src, span<float> dst, float scale, float offset);
+
+        // dst[i] = function(src[i]) through raw pointers, which the compiler vectorizes for simple functions
+        template <typename T, typename U, typename Function>
+        void transform(span<T> src, span<U> dst, Function function)
+        {
+            coda_assert(dst.getSize() >= src.getSize());
+            const T* from = src.getData();
+            U* to = dst.getData();
+            for (uint32 i = 0, size = src.getSize(); i < size; ++i)
+                to[i] = function(from[i]);
+        }
+    }
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "common.h"
+#include "span.h"
+#include <cstring>
+#include <type_traits>
+
+namespace coda
+{
+    // simd::fill on its own so containers fill with it without including the rest of simd.h
+    namespace simd
+    {
+        // Vector kernels in simd.cpp
+        void fill(span<float> values, float value);
+        void fill(span<int32> values, int32 value);
+        void fill(span<uint32> values, uint32 value);
+
+        // Any other trivially copyable type is filled with memset when all its bytes are the same,
+        // with plain stores otherwise
+        template <typename T>
+        void fill(span<T> values, const T& value)
+        {
+            static_assert(std::is_trivially_copyable<T>::value, "simd::fill needs a trivially copyable type");
+            const byte* bytes = reinterpret_cast<const byte*>(&value);
+            bool repeated = true;
+            for (size_t i = 1; i < sizeof(T) && repeated; ++i)
+                repeated = bytes[i] == bytes[0];
+            if (repeated)
+            {
+                if (values.getSize())
+                    memset(static_cast<void*>(values.getData()), bytes[0], values.getSize() * sizeof(T));
+                return;
+            }
+            T* data = values.getData();
+            for (uint32 i = 0, size = values.getSize(); i < size; ++i)
+                data[i] = value;
+        }
+    }
+}
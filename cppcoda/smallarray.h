@@ -0,0 +1,331 @@
+#pragma once
+
+#include "common.h"
+#include "allocator.h"
+#include "arrayops.h"
+#include "instrumentation.h"
+#include "span.h"
+#include <cmath>
+#include <utility>
+
+namespace coda
+{
+    /**
+     * Array storing up to N elements inside the object, like a starray, and moving them to memory
+     * from AllocatorType only when it outgrows them. Shrinking back to N elements or less returns to
+     * the inline storage. Same API as dynarray, the capacity is never below N.
+     * Inline elements live in the object, so moving an array moves its elements one by one.
+     */
+    template <typename T, uint32 N, typename AllocatorType = coda::baseallocator>
+    class smallarray : private allocatorholder<AllocatorType>
+    {
+        typedef smallarray<T, N, AllocatorType> self_type;
+        typedef allocatorholder<AllocatorType> allocator_holder;
+        static_assert(N > 0, "smallarray needs inline storage, use dynarray otherwise");
+    public:
+        typedef T value_type;
+        typedef uint32 size_type;
+        typedef AllocatorType allocator_type;
+        typedef T* iterator;
+        typedef const T* const_iterator;
+
+        static constexpr size_type inlineCapacity = N;
+        static constexpr float defaultIncrementFactor = 1.5f;
+        // Alignment of the heap storage, see CODA_STORAGE_ALIGNMENT
+        static constexpr size_t storageAlignment = storage_alignment<value_type>::value;
+
+        smallarray(const allocator_type& allocator = allocator_type())
+            : allocator_holder(allocator), m_data(getInlineData()), m_size(0), m_capacity(N), m_incrementFactor(defaultIncrementFactor) {}
+        smallarray(size_type capacity, const allocator_type& allocator = allocator_type())
+            : allocator_holder(allocator), m_data(getInlineData()), m_size(0), m_capacity(N), m_incrementFactor(defaultIncrementFactor)
+        {
+            reserve(capacity);
+        }
+        smallarray(const self_type& other)
+            : allocator_holder(other.getAllocator()), m_data(getInlineData()), m_size(0), m_capacity(N), m_incrementFactor(other.m_incrementFactor)
+        {
+            copyFrom(other);
+        }
+        smallarray(self_type&& other)
+            : allocator_holder(other.getAllocator()), m_data(getInlineData()), m_size(0), m_capacity(N), m_incrementFactor(other.m_incrementFactor)
+        {
+            moveFrom(other);
+        }
+        ~smallarray() { clear(true); }
+
+        self_type& operator=(const self_type& other)
+        {
+            if (this != &other)
+            {
+                clear();
+                copyFrom(other);
+            }
+            return *this;
+        }
+
+        self_type& operator=(self_type&& other)
+        {
+            if (this != &other)
+            {
+                clear(true);
+                getAllocator() = other.getAllocator();
+                moveFrom(other);
+            }
+            return *this;
+        }
+
+        void setIncrementFactor(float factor = defaultIncrementFactor) { m_incrementFactor = factor; }
+
+        // Like dynarray::reserve, elements past newCapacity are destroyed
+        void reserve(size_type newCapacity)
+        {
+            if (newCapacity < m_size)
+            {
+                arrayops::destroy(m_data, newCapacity, m_size);
+                m_size = newCapacity;
+            }
+            size_type capacity = newCapacity > N ? newCapacity : N;
+            if (capacity != m_capacity)
+                relocate(capacity);
+        }
+
+        // New elements are value initialized
+        void resize(size_type newSize)
+        {
+            if (newSize == m_size)
+                return;
+
+            if (newSize > m_size)
+            {
+                if (newSize > m_capacity)
+                    reserve(newSize);
+                arrayops::construct(m_data, m_size, newSize);
+                m_size = newSize;
+            }
+            else
+            {
+                arrayops::destroy(m_data, newSize, m_size);
+                m_size = newSize;
+                shrink();
+            }
+        }
+
+        void fill(const value_type& value, size_type first, size_type count)
+        {
+            coda_assert(first + count <= m_size);
+            arrayops::fill(m_data + first, count, value);
+        }
+
+        // Fits the capacity to the size, back to the inline storage if the elements fit in it
+        void shrink()
+        {
+            size_type capacity = m_size > N ? m_size : N;
+            if (capacity != m_capacity)
+                relocate(capacity);
+        }
+
+        void clear(bool releaseMemory = false)
+        {
+            arrayops::destroy(m_data, 0, m_size);
+            m_size = 0;
+            if (releaseMemory)
+                shrink();
+        }
+
+        value_type& pushBack(const value_type& value) { return emplaceBack(value); }
+        value_type& pushBack(value_type&& value) { return emplaceBack(std::move(value)); }
+        value_type& pushBack() { return emplaceBack(); }
+
+        template <typename... Args>
+        value_type& emplaceBack(Args&&... args)
+        {
+            if (m_size < m_capacity)
+            {
+                arrayops::construct(m_data + m_size, std::forward<Args>(args)...);
+                return m_data[m_size++];
+            }
+            value_type value(std::forward<Args>(args)...);
+            grow();
+            arrayops::construct(m_data + m_size, std::move(value));
+            return m_data[m_size++];
+        }
+
+        value_type& insert(size_type index, const value_type& value) { return emplace(index, value); }
+        value_type& insert(size_type index, value_type&& value) { return emplace(index, std::move(value)); }
+
+        template <typename... Args>
+        value_type& emplace(size_type index, Args&&... args)
+        {
+            coda_assert(index <= m_size);
+            if (index == m_size)
+                return emplaceBack(std::forward<Args>(args)...);
+
+            value_type value(std::forward<Args>(args)...);
+            if (m_size == m_capacity)
+                grow();
+            arrayops::insert(m_data, m_size, index, std::move(value));
+            ++m_size;
+            return m_data[index];
+        }
+
+        void erase(size_type index)
+        {
+            coda_assert(index < m_size);
+            arrayops::erase(m_data, m_size, index);
+            --m_size;
+        }
+
+        void popBack()
+        {
+            coda_assert(m_size > 0);
+            arrayops::destroy(m_data + --m_size);
+        }
+
+        bool isEmpty() const { return m_size == 0; }
+        // True while the elements are stored in the object
+        bool isInline() const { return m_data == getInlineData(); }
+        size_type getSize() const { return m_size; }
+        size_type getCapacity() const { return m_capacity; }
+        value_type* getData() { return m_data; }
+        const value_type* getData() const { return m_data; }
+        bool isValidIndex(size_type index) const { return index < m_size; }
+        using allocator_holder::getAllocator;
+
+#if CODA_INSTRUMENTATION
+        const arraystats& getStats() const { return m_stats; }
+#else
+        // Never updated
+        const arraystats& getStats() const { static const arraystats empty; return empty; }
+#endif
+
+        value_type& operator[](size_type index)
+        {
+            coda_assert(index < m_size);
+            return m_data[index];
+        }
+
+        const value_type& operator[](size_type index) const
+        {
+            coda_assert(index < m_size);
+            return m_data[index];
+        }
+
+        // No bounds check below CODA_CHECK_LEVEL 2, for hot loops
+        value_type& at_unchecked(size_type index)
+        {
+            coda_paranoid_assert(index < m_size);
+            return m_data[index];
+        }
+
+        const value_type& at_unchecked(size_type index) const
+        {
+            coda_paranoid_assert(index < m_size);
+            return m_data[index];
+        }
+
+        iterator begin() { return m_data; }
+        iterator end() { return m_data + m_size; }
+        const_iterator begin() const { return m_data; }
+        const_iterator end() const { return m_data + m_size; }
+
+        span<value_type> getSpan() { return span<value_type>(m_data, m_size); }
+        span<const value_type> getSpan() const { return span<const value_type>(m_data, m_size); }
+
+    private:
+        value_type* getInlineData() { return reinterpret_cast<value_type*>(m_inline); }
+        const value_type* getInlineData() const { return reinterpret_cast<const value_type*>(m_inline); }
+
+        void grow()
+        {
+            coda_assert(m_incrementFactor > 1.f);
+            size_type newCapacity = static_cast<size_type>(ceilf((float)m_capacity * m_incrementFactor));
+            coda_dbg_assert(newCapacity > m_capacity);
+            coda_instrument(recordArrayStats(m_stats, [](arraystats& s) { s.regrowths.add(); }));
+            relocate(newCapacity);
+        }
+
+        // Moves the elements to the inline storage when newCapacity is N, to the heap otherwise
+        void relocate(size_type newCapacity)
+        {
+            coda_dbg_assert(newCapacity >= m_size && newCapacity >= N);
+            CODA_TRACE_ZONE("smallarray::relocate");
+            coda_instrument(recordArrayStats(m_stats, [this](arraystats& s) { s.recordRelocation(static_cast<uint64>(m_size) * sizeof(value_type)); }));
+            if (newCapacity == N)
+            {
+                value_type* heapData = m_data;
+                moveElements(getInlineData());
+                releaseAligned(getAllocator(), heapData, storageAlignment);
+                m_data = getInlineData();
+            }
+            else if constexpr (is_trivially_relocatable<value_type>::value)
+            {
+                if (isInline())
+                {
+                    value_type* newData = allocate(newCapacity);
+                    moveElements(newData);
+                    m_data = newData;
+                }
+                else
+                {
+                    m_data = (value_type*)reallocateAligned(getAllocator(), m_data, m_capacity * sizeof(value_type), newCapacity * sizeof(value_type), storageAlignment);
+                    coda_assert(m_data != nullptr);
+                }
+            }
+            else
+            {
+                value_type* newData = allocate(newCapacity);
+                moveElements(newData);
+                if (!isInline())
+                    releaseAligned(getAllocator(), m_data, storageAlignment);
+                m_data = newData;
+            }
+            m_capacity = newCapacity;
+        }
+
+        // Moves the elements to data, leaving nothing to destroy in the current storage
+        void moveElements(value_type* data) { arrayops::relocate(m_data, data, m_size); }
+
+        void copyFrom(const self_type& other)
+        {
+            if (other.m_size > m_capacity)
+                reserve(other.m_size);
+            arrayops::copy(m_data, other.m_data, other.m_size);
+            m_size = other.m_size;
+        }
+
+        // Takes the heap storage of other or moves its inline elements, this must be empty and inline
+        void moveFrom(self_type& other)
+        {
+            if (other.isInline())
+            {
+                other.moveElements(m_data);
+            }
+            else
+            {
+                m_data = other.m_data;
+                m_capacity = other.m_capacity;
+                other.m_data = other.getInlineData();
+                other.m_capacity = N;
+            }
+            m_size = other.m_size;
+            other.m_size = 0;
+        }
+
+        value_type* allocate(size_type count)
+        {
+            value_type* data = (value_type*)allocateAligned(getAllocator(), count * sizeof(value_type), storageAlignment);
+            coda_assert(data != nullptr);
+            return data;
+        }
+
+    private:
+        value_type* m_data;
+        size_type m_size;
+        size_type m_capacity;
+        float m_incrementFactor;
+#if CODA_INSTRUMENTATION
+        arraystats m_stats;
+#endif
+        alignas(value_type) byte m_inline[N * sizeof(value_type)];
+    };
+}
@@ -0,0 +1,396 @@
+#pragma once
+
+#include "common.h"
+#include "allocator.h"
+#include "instrumentation.h"
+#include "span.h"
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <tuple>
+#include <utility>
+
+namespace coda
+{
+    /**
+     * Struct of arrays: every field of the records gets its own contiguous column, sharing a single
+     * size and capacity. Columns are carved from one allocation and start on a cache line boundary,
+     * so a pass over one field only reads that field and vectorizes like a plain array loop.
+     * Records are accessed as a whole through row proxies.
+     */
+    template <typename AllocatorType, typename... Fields>
+    class soaarray_base : private allocatorholder<AllocatorType>
+    {
+        typedef soaarray_base<AllocatorType, Fields...> self_type;
+        typedef allocatorholder<AllocatorType> allocator_holder;
+        typedef std::index_sequence_for<Fields...> field_indices;
+        static_assert(sizeof...(Fields) > 0, "soaarray needs at least one field");
+    public:
+        typedef uint32 size_type;
+        typedef AllocatorType allocator_type;
+
+        template <size_t I>
+        using field_type = typename std::tuple_element<I, std::tuple<Fields...>>::type;
+
+        static constexpr size_t fieldCount = sizeof...(Fields);
+        static constexpr size_t columnAlignment = 64;
+        static constexpr float defaultIncrementFactor = 1.5f;
+        static constexpr size_type minGrowCapacity = 4;
+
+        // Proxy to the fields of one record, invalidated when the array grows
+        template <bool Const>
+        class rowbase
+        {
+            typedef typename std::conditional<Const, const self_type, self_type>::type array_type;
+        public:
+            rowbase(array_type* _array, size_type _index) : array(_array), index(_index) {}
+
+            template <size_t I>
+            auto& get() const { return array->template getData<I>()[index]; }
+            size_type getIndex() const { return index; }
+
+        private:
+            array_type* array;
+            size_type index;
+        };
+        typedef rowbase<false> row;
+        typedef rowbase<true> const_row;
+
+        soaarray_base(const allocator_type& allocator = allocator_type())
+            : allocator_holder(allocator), m_memory(nullptr), m_columns(), m_size(0), m_capacity(0), m_incrementFactor(defaultIncrementFactor) {}
+        soaarray_base(size_type capacity, const allocator_type& allocator = allocator_type())
+            : allocator_holder(allocator), m_memory(nullptr), m_columns(), m_size(0), m_capacity(0), m_incrementFactor(defaultIncrementFactor)
+        {
+            reserve(capacity);
+        }
+        soaarray_base(const self_type& other)
+            : allocator_holder(other.getAllocator()), m_memory(nullptr), m_columns(), m_size(0), m_capacity(0), m_incrementFactor(other.m_incrementFactor)
+        {
+            copyFrom(other);
+        }
+        soaarray_base(self_type&& other)
+            : allocator_holder(other.getAllocator()), m_memory(nullptr), m_columns(), m_size(0), m_capacity(0), m_incrementFactor(other.m_incrementFactor)
+        {
+            takeFrom(other);
+        }
+        ~soaarray_base() { clear(true); }
+
+        self_type& operator=(const self_type& other)
+        {
+            if (this != &other)
+            {
+                clear();
+                copyFrom(other);
+            }
+            return *this;
+        }
+
+        self_type& operator=(self_type&& other)
+        {
+            if (this != &other)
+            {
+                clear(true);
+                getAllocator() = other.getAllocator();
+                takeFrom(other);
+            }
+            return *this;
+        }
+
+        void setIncrementFactor(float factor = defaultIncrementFactor) { m_incrementFactor = factor; }
+
+        // Like dynarray::reserve, records past newCapacity are destroyed
+        void reserve(size_type newCapacity)
+        {
+            if (newCapacity < m_size)
+            {
+                destroyRecords(newCapacity, m_size);
+                m_size = newCapacity;
+            }
+            if (newCapacity != m_capacity)
+                relocate(newCapacity);
+        }
+
+        // New records are value initialized
+        void resize(size_type newSize)
+        {
+            if (newSize > m_size)
+            {
+                if (newSize > m_capacity)
+                    reserve(newSize);
+                for (size_type i = m_size; i < newSize; ++i)
+                    constructRecord(i, field_indices());
+                m_size = newSize;
+            }
+            else if (newSize < m_size)
+            {
+                destroyRecords(newSize, m_size);
+                m_size = newSize;
+                shrink();
+            }
+        }
+
+        void shrink()
+        {
+            if (m_size != m_capacity)
+                relocate(m_size);
+        }
+
+        void clear(bool releaseMemory = false)
+        {
+            destroyRecords(0, m_size);
+            m_size = 0;
+            if (releaseMemory)
+                shrink();
+        }
+
+        // Appends a record from one value per field
+        template <typename... Values>
+        row pushBack(Values&&... values)
+        {
+            static_assert(sizeof...(Values) == fieldCount || sizeof...(Values) == 0, "pushBack takes a value for every field or none");
+            if (m_size < m_capacity)
+            {
+                constructRecord(m_size, field_indices(), std::forward<Values>(values)...);
+            }
+            else if constexpr (sizeof...(Values) == 0)
+            {
+                grow();
+                constructRecord(m_size, field_indices());
+            }
+            else
+            {
+                // values may refer to a record, build them before the columns move
+                std::tuple<Fields...> temp(std::forward<Values>(values)...);
+                grow();
+                moveRecord(m_size, temp, field_indices());
+            }
+            return row(this, m_size++);
+        }
+
+        void popBack()
+        {
+            coda_assert(m_size > 0);
+            --m_size;
+            destroyRecords(m_size, m_size + 1);
+        }
+
+        // Moves the records after index one position down
+        void erase(size_type index)
+        {
+            coda_assert(index < m_size);
+            forEachField([this, index](auto field)
+                {
+                    typedef field_type<decltype(field)::value> T;
+                    T* data = getData<decltype(field)::value>();
+                    for (size_type i = index + 1; i < m_size; ++i)
+                        data[i - 1] = std::move(data[i]);
+                    data[m_size - 1].~T();
+                });
+            --m_size;
+        }
+
+        // Replaces index with the last record, O(1) but changes the order
+        void eraseSwap(size_type index)
+        {
+            coda_assert(index < m_size);
+            forEachField([this, index](auto field)
+                {
+                    typedef field_type<decltype(field)::value> T;
+                    T* data = getData<decltype(field)::value>();
+                    if (index != m_size - 1)
+                        data[index] = std::move(data[m_size - 1]);
+                    data[m_size - 1].~T();
+                });
+            --m_size;
+        }
+
+        bool isEmpty() const { return m_size == 0; }
+        size_type getSize() const { return m_size; }
+        size_type getCapacity() const { return m_capacity; }
+        bool isValidIndex(size_type index) const { return index < m_size; }
+        using allocator_holder::getAllocator;
+
+        // Column of field I, aligned to columnAlignment
+        template <size_t I>
+        field_type<I>* getData() { return static_cast<field_type<I>*>(m_columns[I]); }
+        template <size_t I>
+        const field_type<I>* getData() const { return static_cast<const field_type<I>*>(m_columns[I]); }
+
+        template <size_t I>
+        span<field_type<I>> getColumn() { return span<field_type<I>>(getData<I>(), m_size); }
+        template <size_t I>
+        span<const field_type<I>> getColumn() const { return span<const field_type<I>>(getData<I>(), m_size); }
+
+        row operator[](size_type index)
+        {
+            coda_assert(index < m_size);
+            return row(this, index);
+        }
+
+        const_row operator[](size_type index) const
+        {
+            coda_assert(index < m_size);
+            return const_row(this, index);
+        }
+
+#if CODA_INSTRUMENTATION
+        const arraystats& getStats() const { return m_stats; }
+#else
+        // Never updated
+        const arraystats& getStats() const { static const arraystats empty; return empty; }
+#endif
+
+    private:
+        // Calls function(std::integral_constant<size_t, I>) for every field
+        template <typename Function, size_t... I>
+        static void forEachField(Function&& function, std::index_sequence<I...>)
+        {
+            (function(std::integral_constant<size_t, I>()), ...);
+        }
+
+        template <typename Function>
+        static void forEachField(Function&& function)
+        {
+            forEachField(function, field_indices());
+        }
+
+        template <size_t... I, typename... Values>
+        void constructRecord(size_type index, std::index_sequence<I...>, Values&&... values)
+        {
+            if constexpr (sizeof...(Values) == 0)
+                (new (&getData<I>()[index]) field_type<I>(), ...);
+            else
+                (new (&getData<I>()[index]) field_type<I>(std::forward<Values>(values)), ...);
+        }
+
+        template <size_t... I>
+        void moveRecord(size_type index, std::tuple<Fields...>& values, std::index_sequence<I...>)
+        {
+            (new (&getData<I>()[index]) field_type<I>(std::move(std::get<I>(values))), ...);
+        }
+
+        void destroyRecords(size_type first, size_type end)
+        {
+            forEachField([this, first, end](auto field)
+                {
+                    typedef field_type<decltype(field)::value> T;
+                    T* data = getData<decltype(field)::value>();
+                    for (size_type i = first; i < end; ++i)
+                        data[i].~T();
+                });
+        }
+
+        static size_t alignColumn(size_t offset) { return (offset + columnAlignment - 1) & ~(columnAlignment - 1); }
+
+        void grow()
+        {
+            coda_assert(m_incrementFactor > 1.f);
+            size_type newCapacity = m_capacity ? static_cast<size_type>(ceilf((float)m_capacity * m_incrementFactor)) : minGrowCapacity;
+            coda_dbg_assert(newCapacity > m_capacity);
+            coda_instrument(recordArrayStats(m_stats, [](arraystats& s) { s.regrowths.add(); }));
+            relocate(newCapacity);
+        }
+
+        // Moves the records to a new block with room for newCapacity, which must hold all of them
+        void relocate(size_type newCapacity)
+        {
+            coda_dbg_assert(newCapacity >= m_size);
+            CODA_TRACE_ZONE("soaarray::relocate");
+            coda_instrument(recordArrayStats(m_stats, [this](arraystats& s) { s.recordRelocation(static_cast<uint64>(m_size) * (sizeof(Fields) + ...)); }));
+
+            void* newMemory = nullptr;
+            void* newColumns[fieldCount] = {};
+            if (newCapacity)
+            {
+                size_t columnOffsets[fieldCount];
+                size_t total = 0;
+                size_t sizes[fieldCount] = { sizeof(Fields)... };
+                for (size_t i = 0; i < fieldCount; ++i)
+                {
+                    columnOffsets[i] = total;
+                    total = alignColumn(total + sizes[i] * newCapacity);
+                }
+                newMemory = allocateAligned(getAllocator(), total, columnAlignment);
+                coda_assert(newMemory != nullptr);
+                for (size_t i = 0; i < fieldCount; ++i)
+                    newColumns[i] = static_cast<byte*>(newMemory) + columnOffsets[i];
+            }
+
+            forEachField([this, &newColumns](auto field)
+                {
+                    constexpr size_t I = decltype(field)::value;
+                    typedef field_type<I> T;
+                    T* from = getData<I>();
+                    T* to = static_cast<T*>(newColumns[I]);
+                    if constexpr (is_trivially_relocatable<T>::value)
+                    {
+                        if (m_size)
+                            memcpy(static_cast<void*>(to), static_cast<const void*>(from), m_size * sizeof(T));
+                    }
+                    else
+                    {
+                        for (size_type i = 0; i < m_size; ++i)
+                        {
+                            new (&to[i]) T(std::move(from[i]));
+                            from[i].~T();
+                        }
+                    }
+                });
+
+            if (m_memory)
+                releaseAligned(getAllocator(), m_memory, columnAlignment);
+            m_memory = newMemory;
+            for (size_t i = 0; i < fieldCount; ++i)
+                m_columns[i] = newColumns[i];
+            m_capacity = newCapacity;
+        }
+
+        void copyFrom(const self_type& other)
+        {
+            if (other.m_size > m_capacity)
+                reserve(other.m_size);
+            forEachField([this, &other](auto field)
+                {
+                    constexpr size_t I = decltype(field)::value;
+                    const field_type<I>* from = other.template getData<I>();
+                    field_type<I>* to = getData<I>();
+                    for (size_type i = 0; i < other.m_size; ++i)
+                        new (&to[i]) field_type<I>(from[i]);
+                });
+            m_size = other.m_size;
+        }
+
+        // Takes the storage of other, this must hold no memory
+        void takeFrom(self_type& other)
+        {
+            m_memory = other.m_memory;
+            for (size_t i = 0; i < fieldCount; ++i)
+            {
+                m_columns[i] = other.m_columns[i];
+                other.m_columns[i] = nullptr;
+            }
+            m_size = other.m_size;
+            m_capacity = other.m_capacity;
+            other.m_memory = nullptr;
+            other.m_size = 0;
+            other.m_capacity = 0;
+        }
+
+    private:
+        void* m_memory;
+        void* m_columns[fieldCount];
+        size_type m_size;
+        size_type m_capacity;
+        float m_incrementFactor;
+#if CODA_INSTRUMENTATION
+        arraystats m_stats;
+#endif
+    };
+
+    template <typename... Fields>
+    using soaarray = soaarray_base<baseallocator, Fields...>;
+
+    template <typename AllocatorType, typename... Fields>
+    struct is_trivially_relocatable<soaarray_base<AllocatorType, Fields...>> : is_trivially_relocatable<AllocatorType> {};
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "common.h"
+#include <type_traits>
+
+namespace coda
+{
+    /**
+     * Non owning view over contiguous elements. Iteration goes through raw pointers and element
+     * access is only checked with CODA_CHECK_LEVEL >= 1, so loops over a span vectorize like loops
+     * over a plain array. The elements must outlive the span.
+     */
+    template <typename T>
+    class span
+    {
+    public:
+        typedef T value_type;
+        typedef uint32 size_type;
+        typedef T* iterator;
+
+        span() : m_data(nullptr), m_size(0) {}
+        span(T* data, size_type size) : m_data(data), m_size(size) {}
+        template <uint32 N>
+        span(T (&data)[N]) : m_data(data), m_size(N) {}
+        // span<T> to span<const T>
+        template <typename U, typename = typename std::enable_if<std::is_convertible<U(*)[], T(*)[]>::value>::type>
+        span(const span<U>& other) : m_data(other.getData()), m_size(other.getSize()) {}
+
+        T* getData() const { return m_data; }
+        size_type getSize() const { return m_size; }
+        bool isEmpty() const { return m_size == 0; }
+
+        // count is clamped to the elements left after offset
+        span getSubspan(size_type offset, size_type count = TypeLimit<size_type>::max()) const
+        {
+            coda_assert(offset <= m_size);
+            size_type left = m_size - offset;
+            return span(m_data + offset, count < left ? count : left);
+        }
+
+        T& operator[](size_type index) const
+        {
+            coda_dbg_assert(index < m_size);
+            return m_data[index];
+        }
+
+        T* begin() const { return m_data; }
+        T* end() const { return m_data + m_size; }
+
+    private:
+        T* m_data;
+        size_type m_size;
+    };
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "common.h"
+#include "span.h"
 
 namespace coda
 {
@@ -8,9 +9,11 @@ namespace coda
     class starray
     {
         typedef starray<T, N> self_type;
+    public:
         typedef T value_type;
         typedef uint32 size_type;
-    public:
+        typedef T* iterator;
+        typedef const T* const_iterator;
 
         starray() : m_size(0) {}
 
@@ -76,14 +79,41 @@ namespace coda
         const value_type* getData() const { return reinterpret_cast<const value_type*>(m_data); }
         bool isValidIndex(size_type index) const { return index < m_size; }
 
+        value_type& operator[](size_type index)
+        {
+            coda_assert(index < m_size);
+            return getData()[index];
+        }
+
         const value_type& operator[](size_type index) const
         {
             coda_assert(index < m_size);
-            return *reinterpret_cast<const value_type*>(&m_data[index * sizeof(value_type)]);
+            return getData()[index];
+        }
+
+        // No bounds check below CODA_CHECK_LEVEL 2, for hot loops
+        value_type& at_unchecked(size_type index)
+        {
+            coda_paranoid_assert(index < m_size);
+            return getData()[index];
         }
 
+        const value_type& at_unchecked(size_type index) const
+        {
+            coda_paranoid_assert(index < m_size);
+            return getData()[index];
+        }
+
+        iterator begin() { return getData(); }
+        iterator end() { return getData() + m_size; }
+        const_iterator begin() const { return getData(); }
+        const_iterator end() const { return getData() + m_size; }
+
+        span<value_type> getSpan() { return span<value_type>(getData(), m_size); }
+        span<const value_type> getSpan() const { return span<const value_type>(getData(), m_size); }
+
     private:
-        byte m_data[N*sizeof(value_type)];
+        alignas(value_type) byte m_data[N * sizeof(value_type)];
         size_type m_size;
     };
 }
\ No newline at end of file
@@ -0,0 +1,106 @@
+#include "stringinterner.h"
+#include <cstring>
+#include <mutex>
+
+namespace coda
+{
+    stringinterner::stringinterner(uint32 _size, size_t _blockSize)
+        : lookup(_size), symbols(_size), storage(_blockSize + 2 * arena::alignment), cursor(nullptr), end(nullptr), blockSize(_blockSize), storageBytes(0)
+    {
+        coda_assert(blockSize > 0);
+    }
+
+    symbol stringinterner::intern(stringview str)
+    {
+        if (const uint32* id = lookup.findItem(str))
+            return symbol{ *id };
+
+        symbol sym{ symbols.getSize() };
+        coda_assert(sym.id != symbol::invalidId);
+        stringview stored(store(str), str.getLength());
+        lookup.createItem(stored, sym.id);
+        symbols.pushBack(stored);
+        return sym;
+    }
+
+    symbol stringinterner::find(stringview str) const
+    {
+        const uint32* id = lookup.findItem(str);
+        return id ? symbol{ *id } : symbol();
+    }
+
+    const char* stringinterner::store(stringview str)
+    {
+        size_t size = str.getLength() + 1;
+        char* data;
+        if (size > blockSize)
+        {
+            // oversized strings get their own block and leave the current one open
+            data = static_cast<char*>(storage.allocate(size));
+        }
+        else
+        {
+            if (static_cast<size_t>(end - cursor) < size)
+            {
+                cursor = static_cast<char*>(storage.allocate(blockSize));
+                end = cursor + blockSize;
+            }
+            data = cursor;
+            cursor += size;
+        }
+        coda_assert(data);
+        if (str.getLength())
+            memcpy(data, str.getData(), str.getLength());
+        data[str.getLength()] = 0;
+        storageBytes += size;
+        return data;
+    }
+
+    symbol concurrentstringinterner::intern(stringview str)
+    {
+        if (isFrozen())
+            return interner.find(str);
+        {
+            std::shared_lock<std::shared_mutex> readLock(lock);
+            symbol sym = interner.find(str);
+            if (sym.isValid())
+                return sym;
+        }
+        std::unique_lock<std::shared_mutex> writeLock(lock);
+        // frozen or added by another thread meanwhile
+        if (isFrozen())
+            return interner.find(str);
+        return interner.intern(str);
+    }
+
+    symbol concurrentstringinterner::find(stringview str) const
+    {
+        if (isFrozen())
+            return interner.find(str);
+        std::shared_lock<std::shared_mutex> readLock(lock);
+        return interner.find(str);
+    }
+
+    stringview concurrentstringinterner::getString(symbol sym) const
+    {
+        if (isFrozen())
+            return interner.getString(sym);
+        std::shared_lock<std::shared_mutex> readLock(lock);
+        return interner.getString(sym);
+    }
+
+    uint32 concurrentstringinterner::getCount() const
+    {
+        if (isFrozen())
+            return interner.getCount();
+        std::shared_lock<std::shared_mutex> readLock(lock);
+        return interner.getCount();
+    }
+
+    void concurrentstringinterner::freeze()
+    {
+        // waits for the writers still interning
+        std::unique_lock<std::shared_mutex> writeLock(lock);
+        frozen.store(true, std::memory_order_release);
+    }
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "common.h"
+#include "arena.h"
+#include "dynarray.h"
+#include "hashtable.h"
+#include "stringview.h"
+#include <atomic>
+#include <shared_mutex>
+
+namespace coda
+{
+    // Interned string handle, equal symbols of the same interner mean equal strings.
+    struct symbol
+    {
+        static constexpr uint32 invalidId = 0xffffffff;
+
+        uint32 id = invalidId;
+
+        bool isValid() const { return id != invalidId; }
+        bool operator==(symbol other) const { return id == other.id; }
+        bool operator!=(symbol other) const { return id != other.id; }
+    };
+
+    template <>
+    struct hasher<symbol>
+    {
+        uint64 operator()(symbol value) const { return hashInteger(value.id); }
+    };
+
+    /**
+     * Deduplicates strings and hands out a symbol per distinct string, numbered from 0 in
+     * interning order. Characters are packed back to back, null terminated, in large blocks taken
+     * from an arena, and stay in place until the interner is destroyed.
+     * Not thread safe, see concurrentstringinterner.
+     */
+    class stringinterner
+    {
+    public:
+        static constexpr size_t defaultBlockSize = 64 * 1024;
+
+        stringinterner(uint32 _size = 1024, size_t _blockSize = defaultBlockSize);
+
+        stringinterner(const stringinterner&) = delete;
+        stringinterner& operator=(const stringinterner&) = delete;
+
+        // Symbol of str, adding it if new
+        symbol intern(stringview str);
+        // Invalid symbol if str was never interned
+        symbol find(stringview str) const;
+
+        stringview getString(symbol sym) const
+        {
+            coda_assert(sym.id < symbols.getSize());
+            return symbols[sym.id];
+        }
+        const char* c_str(symbol sym) const { return getString(sym).getData(); }
+
+        uint32 getCount() const { return symbols.getSize(); }
+        // Bytes used by the characters, terminators included
+        size_t getStorageBytes() const { return storageBytes; }
+
+    private:
+        const char* store(stringview str);
+
+    private:
+        hashtable<stringview, uint32> lookup;
+        dynarray<stringview> symbols;
+        arena storage;
+        char* cursor;
+        char* end;
+        size_t blockSize;
+        size_t storageBytes;
+    };
+
+    /**
+     * stringinterner safe to use from several threads at once. Lookups take a reader-writer lock
+     * shared, new strings take it exclusive. Once freeze() is called the vocabulary is fixed and
+     * every call is lock free, interning a string that is not there yet returns an invalid symbol.
+     */
+    class concurrentstringinterner
+    {
+    public:
+        concurrentstringinterner(uint32 _size = 1024, size_t _blockSize = stringinterner::defaultBlockSize) : interner(_size, _blockSize), frozen(false) {}
+
+        symbol intern(stringview str);
+        symbol find(stringview str) const;
+        stringview getString(symbol sym) const;
+        const char* c_str(symbol sym) const { return getString(sym).getData(); }
+        uint32 getCount() const;
+
+        void freeze();
+        bool isFrozen() const { return frozen.load(std::memory_order_acquire); }
+
+    private:
+        stringinterner interner;
+        mutable std::shared_mutex lock;
+        std::atomic<bool> frozen;
+    };
+}
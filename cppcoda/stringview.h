@@ -0,0 +1,56 @@
+#pragma once
+
+#include "common.h"
+#include "hash.h"
+#include <cstring>
+
+namespace coda
+{
+    /**
+     * Non owning view of a range of characters, not necessarily null terminated. The characters
+     * must outlive the view.
+     */
+    class stringview
+    {
+    public:
+        constexpr stringview() : m_data(nullptr), m_length(0) {}
+        stringview(const char* str) : m_data(str), m_length(str ? safe_cast<uint32>(strlen(str)) : 0) {}
+        constexpr stringview(const char* str, uint32 length) : m_data(str), m_length(length) {}
+
+        const char* getData() const { return m_data; }
+        uint32 getLength() const { return m_length; }
+        bool isEmpty() const { return !m_length; }
+
+        // count is clamped to the end of the view
+        stringview getSubstring(uint32 offset, uint32 count = TypeLimit<uint32>::max()) const
+        {
+            coda_assert(offset <= m_length);
+            return stringview(m_data + offset, count < m_length - offset ? count : m_length - offset);
+        }
+
+        char operator[](uint32 index) const
+        {
+            coda_assert(index < m_length);
+            return m_data[index];
+        }
+
+        bool operator==(stringview other) const { return m_length == other.m_length && (!m_length || !memcmp(m_data, other.m_data, m_length)); }
+        bool operator!=(stringview other) const { return !(*this == other); }
+
+    private:
+        const char* m_data;
+        uint32 m_length;
+    };
+
+    // same value as hashing the C string
+    template <>
+    struct hasher<stringview>
+    {
+        uint64 operator()(stringview str) const { return hashBytes(str.getData(), str.getLength()); }
+    };
+
+    template <>
+    struct is_hash_compatible<stringview, const char*> : std::true_type {};
+    template <>
+    struct is_hash_compatible<stringview, char*> : std::true_type {};
+}
@@ -0,0 +1,168 @@
+#include "threadpool.h"
+
+namespace coda
+{
+    // Pool and queue of the calling worker thread, null outside every pool
+    static thread_local threadpool* t_pool = nullptr;
+    static thread_local uint32 t_queueIndex = 0;
+
+    // Failed searches before an idle worker goes to sleep
+    static constexpr uint32 g_spinCount = 64;
+
+    threadpool::threadpool(uint32 _workerCount)
+        : workerCount(_workerCount), queues(new workqueue[_workerCount + 1])
+    {
+        workers.reserve(workerCount);
+        for (uint32 i = 0; i < workerCount; ++i)
+            workers.emplace_back([this, i]() { workerMain(i); });
+    }
+
+    threadpool::~threadpool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(sleepLock);
+            stopping = true;
+        }
+        wakeup.notify_all();
+        for (std::thread& worker : workers)
+            worker.join();
+        coda_assert_msg(!hasQueuedTasks(), "threadpool destroyed with queued tasks");
+    }
+
+    void threadpool::push(task* t)
+    {
+        workqueue& queue = queues[getQueueIndex()];
+        {
+            std::lock_guard<std::mutex> lock(queue.lock);
+            queue.tasks.push_back(t);
+            queue.size.store(static_cast<uint32>(queue.tasks.size() - queue.head));
+        }
+        // a worker counts itself as sleeper before checking the queue sizes, one of the two sees the other
+        if (sleeperCount.load())
+        {
+            std::lock_guard<std::mutex> lock(sleepLock);
+            wakeup.notify_one();
+        }
+    }
+
+    bool threadpool::runPending()
+    {
+        uint32 queueIndex = getQueueIndex();
+        task* t = popTask(queueIndex);
+        if (!t)
+            t = stealTask(queueIndex);
+        if (!t)
+            return false;
+        runTask(t);
+        return true;
+    }
+
+    threadpool& threadpool::getDefault()
+    {
+        static threadpool pool(std::thread::hardware_concurrency() > 1 ? std::thread::hardware_concurrency() - 1 : 0);
+        return pool;
+    }
+
+    void threadpool::workerMain(uint32 index)
+    {
+        t_pool = this;
+        t_queueIndex = index;
+        uint32 failures = 0;
+        while (true)
+        {
+            if (runPending())
+            {
+                failures = 0;
+                continue;
+            }
+            if (++failures < g_spinCount)
+            {
+                std::this_thread::yield();
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(sleepLock);
+            sleeperCount.fetch_add(1);
+            wakeup.wait(lock, [this]() { return stopping || hasQueuedTasks(); });
+            sleeperCount.fetch_sub(1);
+            if (stopping && !hasQueuedTasks())
+                break;
+            failures = 0;
+        }
+        t_pool = nullptr;
+    }
+
+    uint32 threadpool::getQueueIndex() const
+    {
+        return t_pool == this ? t_queueIndex : workerCount;
+    }
+
+    task* threadpool::popTask(uint32 queueIndex)
+    {
+        workqueue& queue = queues[queueIndex];
+        if (!queue.size.load(std::memory_order_relaxed))
+            return nullptr;
+        std::lock_guard<std::mutex> lock(queue.lock);
+        if (queue.tasks.size() == queue.head)
+            return nullptr;
+        task* t = queue.tasks.back();
+        queue.tasks.pop_back();
+        if (queue.tasks.size() == queue.head)
+        {
+            queue.tasks.clear();
+            queue.head = 0;
+        }
+        queue.size.store(static_cast<uint32>(queue.tasks.size() - queue.head), std::memory_order_relaxed);
+        return t;
+    }
+
+    task* threadpool::stealTask(uint32 queueIndex)
+    {
+        // from the next queue on so thieves spread over the victims
+        for (uint32 i = 1; i <= workerCount; ++i)
+        {
+            workqueue& queue = queues[(queueIndex + i) % (workerCount + 1)];
+            if (!queue.size.load(std::memory_order_relaxed))
+                continue;
+            std::lock_guard<std::mutex> lock(queue.lock);
+            if (queue.tasks.size() == queue.head)
+                continue;
+            task* t = queue.tasks[queue.head++];
+            if (queue.tasks.size() == queue.head)
+            {
+                queue.tasks.clear();
+                queue.head = 0;
+            }
+            queue.size.store(static_cast<uint32>(queue.tasks.size() - queue.head), std::memory_order_relaxed);
+            return t;
+        }
+        return nullptr;
+    }
+
+    void threadpool::runTask(task* t)
+    {
+        taskgroup* group = t->getGroup();
+        t->run();
+        delete t;
+        group->onTaskDone();
+    }
+
+    bool threadpool::hasQueuedTasks() const
+    {
+        for (uint32 i = 0; i <= workerCount; ++i)
+        {
+            if (queues[i].size.load())
+                return true;
+        }
+        return false;
+    }
+
+    void taskgroup::wait()
+    {
+        while (pendingCount.load(std::memory_order_acquire))
+        {
+            if (!pool.runPending())
+                std::this_thread::yield();
+        }
+    }
+}
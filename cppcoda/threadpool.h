@@ -0,0 +1,139 @@
+#pragma once
+
+#include "common.h"
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace coda
+{
+    class taskgroup;
+
+    // Unit of work queued in a threadpool, deleted once run
+    class task
+    {
+    public:
+        task(taskgroup* _group) : group(_group) {}
+        virtual ~task() = default;
+
+        virtual void run() = 0;
+
+        taskgroup* getGroup() const { return group; }
+
+    private:
+        taskgroup* group;
+    };
+
+    /**
+     * Work stealing thread pool. Every worker owns a deque: it pushes and pops its own tasks at the
+     * back, idle workers steal from the front of the others, so the oldest and usually biggest
+     * pieces of a split range move between threads. Threads outside the pool queue in a shared
+     * deque. Threads waiting on a taskgroup run queued tasks meanwhile, so tasks may wait on nested
+     * groups and a pool without workers still runs everything on the waiting thread.
+     * Idle workers spin a little and then sleep until new tasks are queued. Every deque publishes
+     * its size so thieves skip the empty ones without locking them, queuing only reads the
+     * sleeper count shared by the workers.
+     */
+    class threadpool
+    {
+    public:
+        // 0 workers runs every task in the threads waiting on them
+        explicit threadpool(uint32 workerCount);
+        ~threadpool();
+
+        threadpool(const threadpool&) = delete;
+        threadpool& operator=(const threadpool&) = delete;
+
+        uint32 getWorkerCount() const { return workerCount; }
+        // Workers plus the calling thread
+        uint32 getConcurrency() const { return workerCount + 1; }
+
+        // Queues t in the deque of the calling worker, the shared one from other threads
+        void push(task* t);
+        // Runs a queued task if there is any, own deque first, stealing otherwise
+        bool runPending();
+
+        // Pool used by the parallel algorithms, one worker per hardware thread besides the caller
+        static threadpool& getDefault();
+
+    private:
+        struct alignas(64) workqueue
+        {
+            std::mutex lock;
+            std::vector<task*> tasks;
+            // tasks before head were already stolen
+            size_t head = 0;
+            // tasks.size() - head, read without the lock
+            std::atomic<uint32> size{ 0 };
+        };
+
+        void workerMain(uint32 index);
+        uint32 getQueueIndex() const;
+        task* popTask(uint32 queueIndex);
+        task* stealTask(uint32 queueIndex);
+        void runTask(task* t);
+        bool hasQueuedTasks() const;
+
+    private:
+        uint32 workerCount;
+        // one per worker and the shared one last
+        std::unique_ptr<workqueue[]> queues;
+        std::vector<std::thread> workers;
+        std::atomic<uint32> sleeperCount{ 0 };
+        std::mutex sleepLock;
+        std::condition_variable wakeup;
+        bool stopping = false;
+    };
+
+    /**
+     * Tasks run in a threadpool that can be waited for together. Tasks may add more tasks to their
+     * own group. Destroying a group waits for it.
+     */
+    class taskgroup
+    {
+    public:
+        explicit taskgroup(threadpool& _pool = threadpool::getDefault()) : pool(_pool) {}
+        ~taskgroup() { wait(); }
+
+        taskgroup(const taskgroup&) = delete;
+        taskgroup& operator=(const taskgroup&) = delete;
+
+        // function() must not throw
+        template <typename Function>
+        void run(Function&& function);
+
+        // Runs queued tasks, from this group or others, until every task of the group finished
+        void wait();
+
+        void onTaskDone() { pendingCount.fetch_sub(1, std::memory_order_release); }
+        threadpool& getPool() const { return pool; }
+
+    private:
+        template <typename Function>
+        class functiontask : public task
+        {
+        public:
+            functiontask(taskgroup* group, Function&& _function) : task(group), function(std::forward<Function>(_function)) {}
+            void run() override { function(); }
+
+        private:
+            typename std::decay<Function>::type function;
+        };
+
+    private:
+        threadpool& pool;
+        std::atomic<uint32> pendingCount{ 0 };
+    };
+
+    template <typename Function>
+    inline void taskgroup::run(Function&& function)
+    {
+        pendingCount.fetch_add(1, std::memory_order_relaxed);
+        pool.push(new functiontask<Function>(this, std::forward<Function>(function)));
+    }
+}
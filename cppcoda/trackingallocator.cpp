@@ -0,0 +1,76 @@
+#include "trackingallocator.h"
+
+namespace coda
+{
+    static std::atomic<allocationtag*> g_firstAllocationTag{ nullptr };
+
+    void allocationstats::onAllocate(size_t size)
+    {
+        allocations.fetch_add(1, std::memory_order_relaxed);
+        histogram[getHistogramBucket(size)].fetch_add(1, std::memory_order_relaxed);
+        addLiveBytes(size);
+    }
+
+    void allocationstats::onReallocate(size_t oldSize, size_t newSize)
+    {
+        reallocations.fetch_add(1, std::memory_order_relaxed);
+        histogram[getHistogramBucket(newSize)].fetch_add(1, std::memory_order_relaxed);
+        if (newSize >= oldSize)
+            addLiveBytes(newSize - oldSize);
+        else
+            liveBytes.fetch_sub(oldSize - newSize, std::memory_order_relaxed);
+    }
+
+    void allocationstats::onRelease(size_t size)
+    {
+        releases.fetch_add(1, std::memory_order_relaxed);
+        liveBytes.fetch_sub(size, std::memory_order_relaxed);
+    }
+
+    void allocationstats::addLiveBytes(size_t size)
+    {
+        totalBytes.fetch_add(size, std::memory_order_relaxed);
+        uint64 live = liveBytes.fetch_add(size, std::memory_order_relaxed) + size;
+        uint64 peak = peakBytes.load(std::memory_order_relaxed);
+        while (live > peak && !peakBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed))
+            ;
+    }
+
+    allocationsnapshot allocationstats::getSnapshot() const
+    {
+        allocationsnapshot snapshot;
+        snapshot.allocations = allocations.load(std::memory_order_relaxed);
+        snapshot.reallocations = reallocations.load(std::memory_order_relaxed);
+        snapshot.releases = releases.load(std::memory_order_relaxed);
+        snapshot.liveBytes = liveBytes.load(std::memory_order_relaxed);
+        snapshot.peakBytes = peakBytes.load(std::memory_order_relaxed);
+        snapshot.totalBytes = totalBytes.load(std::memory_order_relaxed);
+        for (uint32 i = 0; i < histogramSize; ++i)
+            snapshot.histogram[i] = histogram[i].load(std::memory_order_relaxed);
+        return snapshot;
+    }
+
+    void allocationstats::reset()
+    {
+        allocations.store(0, std::memory_order_relaxed);
+        reallocations.store(0, std::memory_order_relaxed);
+        releases.store(0, std::memory_order_relaxed);
+        // blocks still alive stay accounted so releasing them later doesn't underflow
+        peakBytes.store(liveBytes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        totalBytes.store(0, std::memory_order_relaxed);
+        for (uint32 i = 0; i < histogramSize; ++i)
+            histogram[i].store(0, std::memory_order_relaxed);
+    }
+
+    allocationtag::allocationtag(const char* _name, const char* _file, int _line)
+        : name(_name), file(_file), line(_line), next(g_firstAllocationTag.load(std::memory_order_relaxed))
+    {
+        while (!g_firstAllocationTag.compare_exchange_weak(next, this, std::memory_order_release, std::memory_order_relaxed))
+            ;
+    }
+
+    allocationtag* allocationtag::getFirst()
+    {
+        return g_firstAllocationTag.load(std::memory_order_acquire);
+    }
+}
@@ -0,0 +1,212 @@
+#pragma once
+
+#include "common.h"
+#include "allocator.h"
+#include <atomic>
+
+// Allocation tracking, 0 turns coda::trackingallocator into the allocator it wraps. Set it the same
+// way for every translation unit, the CPPCODA_ALLOCATION_TRACKING cmake option does it for the
+// library users.
+#ifndef CODA_ALLOCATION_TRACKING
+#define CODA_ALLOCATION_TRACKING 1
+#endif
+
+namespace coda
+{
+    // Plain copy of the counters of an allocationstats
+    struct allocationsnapshot
+    {
+        // sizes in [2^i, 2^(i+1)) land in bucket i, 0 in the first one
+        static constexpr uint32 histogramSize = 32;
+
+        uint64 allocations = 0;
+        uint64 reallocations = 0;
+        uint64 releases = 0;
+        uint64 liveBytes = 0;
+        uint64 peakBytes = 0;
+        uint64 totalBytes = 0;
+        uint64 histogram[histogramSize] = {};
+    };
+
+    /**
+     * Allocation counters safe to update from several threads. Counters are relaxed atomics, a
+     * snapshot taken while other threads allocate may be slightly inconsistent.
+     */
+    class allocationstats
+    {
+    public:
+        static constexpr uint32 histogramSize = allocationsnapshot::histogramSize;
+
+        void onAllocate(size_t size);
+        void onReallocate(size_t oldSize, size_t newSize);
+        void onRelease(size_t size);
+
+        allocationsnapshot getSnapshot() const;
+        void reset();
+
+        static uint32 getHistogramBucket(size_t size)
+        {
+            uint32 bucket = size ? bitScanReverse(size) : 0;
+            return bucket < histogramSize ? bucket : histogramSize - 1;
+        }
+
+    private:
+        void addLiveBytes(size_t size);
+
+    private:
+        std::atomic<uint64> allocations{ 0 };
+        std::atomic<uint64> reallocations{ 0 };
+        std::atomic<uint64> releases{ 0 };
+        std::atomic<uint64> liveBytes{ 0 };
+        std::atomic<uint64> peakBytes{ 0 };
+        std::atomic<uint64> totalBytes{ 0 };
+        std::atomic<uint64> histogram[histogramSize] = {};
+    };
+
+    /**
+     * Named counters for the allocations of one call site, see CODA_ALLOCATION_SITE. Tags live for
+     * the whole program and are linked in a global list to dump them.
+     */
+    class allocationtag
+    {
+    public:
+        allocationtag(const char* _name, const char* _file = "", int _line = 0);
+
+        allocationtag(const allocationtag&) = delete;
+        allocationtag& operator=(const allocationtag&) = delete;
+
+        const char* getName() const { return name; }
+        const char* getFile() const { return file; }
+        int getLine() const { return line; }
+        allocationstats& getStats() { return stats; }
+        const allocationstats& getStats() const { return stats; }
+
+        // Every tag created so far, newest first
+        static allocationtag* getFirst();
+        allocationtag* getNext() const { return next; }
+
+    private:
+        const char* name;
+        const char* file;
+        int line;
+        allocationtag* next;
+        allocationstats stats;
+    };
+
+#if CODA_ALLOCATION_TRACKING
+
+    // Tag owned by the expression's call site, to pass to a trackingallocator
+#define CODA_ALLOCATION_SITE(name) ([]() { static coda::allocationtag tag(name, __FILE__, __LINE__); return &tag; }())
+
+    /**
+     * Allocator adaptor counting the blocks handed out by AllocatorType. Every allocation is
+     * accounted in the stats shared by all the trackingallocators with the same AllocatorType and
+     * Tag, and in the allocation tag given at construction if any. Blocks carry a 16 byte header with their size and
+     * tag so releases are accounted where the block came from.
+     */
+    template <typename AllocatorType = baseallocator, typename Tag = void>
+    class trackingallocator : private allocatorholder<AllocatorType>
+    {
+        typedef allocatorholder<AllocatorType> allocator_holder;
+
+        struct blockheader
+        {
+            size_t size;
+            allocationtag* site;
+        };
+        static_assert(sizeof(blockheader) == 16, "tracking header breaks the alignment");
+
+    public:
+        trackingallocator(const AllocatorType& allocator = AllocatorType()) : allocator_holder(allocator), site(nullptr) {}
+        trackingallocator(allocationtag* _site, const AllocatorType& allocator = AllocatorType()) : allocator_holder(allocator), site(_site) {}
+
+        void* allocate(size_t size)
+        {
+            blockheader* header = static_cast<blockheader*>(getAllocator().allocate(sizeof(blockheader) + size));
+            if (!header)
+                return nullptr;
+            header->size = size;
+            header->site = site;
+            getStats().onAllocate(size);
+            if (site)
+                site->getStats().onAllocate(size);
+            return header + 1;
+        }
+
+        void* reallocate(void* p, size_t size)
+        {
+            if (!p)
+                return allocate(size);
+            blockheader* header = getHeader(p);
+            size_t oldSize = header->size;
+            header = static_cast<blockheader*>(getAllocator().reallocate(header, sizeof(blockheader) + size));
+            if (!header)
+                return nullptr;
+            header->size = size;
+            getStats().onReallocate(oldSize, size);
+            if (header->site)
+                header->site->getStats().onReallocate(oldSize, size);
+            return header + 1;
+        }
+
+        void release(void* p)
+        {
+            if (!p)
+                return;
+            blockheader* header = getHeader(p);
+            getStats().onRelease(header->size);
+            if (header->site)
+                header->site->getStats().onRelease(header->size);
+            getAllocator().release(header);
+        }
+
+        allocationtag* getSite() const { return site; }
+
+        // Stats of every trackingallocator with this AllocatorType and Tag
+        static allocationstats& getStats()
+        {
+            static allocationstats stats;
+            return stats;
+        }
+
+        using allocator_holder::getAllocator;
+
+    private:
+        static blockheader* getHeader(void* p) { return static_cast<blockheader*>(p) - 1; }
+
+    private:
+        allocationtag* site;
+    };
+
+#else
+
+#define CODA_ALLOCATION_SITE(name) static_cast<coda::allocationtag*>(nullptr)
+
+    // Tracking compiled out, forwards straight to AllocatorType and takes no space for stateless ones
+    template <typename AllocatorType = baseallocator, typename Tag = void>
+    class trackingallocator : private allocatorholder<AllocatorType>
+    {
+        typedef allocatorholder<AllocatorType> allocator_holder;
+
+    public:
+        trackingallocator(const AllocatorType& allocator = AllocatorType()) : allocator_holder(allocator) {}
+        trackingallocator(allocationtag*, const AllocatorType& allocator = AllocatorType()) : allocator_holder(allocator) {}
+
+        void* allocate(size_t size) { return getAllocator().allocate(size); }
+        void* reallocate(void* p, size_t size) { return getAllocator().reallocate(p, size); }
+        void release(void* p) { getAllocator().release(p); }
+
+        allocationtag* getSite() const { return nullptr; }
+
+        // Never updated
+        static allocationstats& getStats()
+        {
+            static allocationstats stats;
+            return stats;
+        }
+
+        using allocator_holder::getAllocator;
+    };
+
+#endif
+}
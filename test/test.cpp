@@ -2,10 +2,33 @@
 #include "starray.h"
 #include "dynarray.h"
 #include "codastring.h"
+#include "stringview.h"
+#include "stringinterner.h"
 #include "hashtable.h"
+#include "concurrenthashtable.h"
+#include "arena.h"
+#include "poolallocator.h"
+#include "trackingallocator.h"
+#include "instrumentation.h"
+#include "span.h"
+#include "smallarray.h"
+#include "soaarray.h"
+#include "simd.h"
+#include "threadpool.h"
+#include "parallel.h"
 
 #include "gtest/gtest.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <numeric>
+#include <string>
+#include <thread>
+#include <vector>
+
 
 namespace coda
 {
@@ -114,6 +137,19 @@ namespace coda
 				++releaseCounter;
 				baseallocator::release(p);
 			}
+
+			// counted the same, so CODA_STORAGE_ALIGNMENT over alignof(std::max_align_t) still reallocates in place
+			static void* allocate(size_t size, size_t alignment)
+			{
+				++allocCounter;
+				return baseallocator::allocate(size, alignment);
+			}
+
+			static void* reallocate(void* p, size_t size, size_t alignment)
+			{
+				++reallocCounter;
+				return baseallocator::reallocate(p, size, alignment);
+			}
 		};
 
 		TEST(dynarray, empty)
@@ -164,6 +200,286 @@ namespace coda
 			EXPECT_EQ(c.getCapacity(), 0);
 		}
 
+		TEST(dynarray, pushBack)
+		{
+			dynarray<uint32> c;
+			for (uint32 i = 0; i < 100; ++i)
+				c.pushBack(i);
+			EXPECT_EQ(c.getSize(), 100u);
+			EXPECT_GE(c.getCapacity(), 100u);
+			for (uint32 i = 0; i < 100; ++i)
+				EXPECT_EQ(c[i], i);
+
+			// pushing an element of the array itself while it grows
+			dynarray<uint32> d;
+			d.pushBack(7);
+			for (uint32 i = 0; i < 20; ++i)
+				d.pushBack(d[0]);
+			EXPECT_EQ(d[20], 7u);
+
+			d.resize(30);
+			EXPECT_EQ(d[29], 0u);
+			d.insert(0, 1);
+			d.insert(31, 2);
+			EXPECT_EQ(d[0], 1u);
+			EXPECT_EQ(d[1], 7u);
+			EXPECT_EQ(d[31], 2u);
+			d.erase(0);
+			EXPECT_EQ(d[0], 7u);
+			EXPECT_EQ(d.getSize(), 31u);
+		}
+
+		// counts live objects, never relocated with memcpy
+		struct tracked
+		{
+			static int32 live;
+			tracked(uint32 _value = 0) : value(_value), self(this) { ++live; }
+			tracked(const tracked& other) : value(other.value), self(this) { ++live; }
+			tracked(tracked&& other) : value(other.value), self(this) { other.value = 0; ++live; }
+			tracked& operator=(const tracked& other) { value = other.value; return *this; }
+			tracked& operator=(tracked&& other) { value = other.value; other.value = 0; return *this; }
+			~tracked() { EXPECT_EQ(self, this); --live; }
+			uint32 value;
+			tracked* self;
+		};
+		int32 tracked::live = 0;
+
+		TEST(dynarray, moveElements)
+		{
+			static_assert(coda::is_trivially_relocatable<uint32>::value, "");
+			static_assert(!coda::is_trivially_relocatable<tracked>::value, "");
+			static_assert(coda::is_trivially_relocatable<coda::string>::value, "");
+			{
+				dynarray<tracked> c;
+				for (uint32 i = 0; i < 50; ++i)
+					c.emplaceBack(i);
+				c.insert(10, tracked(100));
+				c.emplace(0, 200);
+				EXPECT_EQ(c.getSize(), 52u);
+				EXPECT_EQ(c[0].value, 200u);
+				EXPECT_EQ(c[11].value, 100u);
+				EXPECT_EQ(c[12].value, 10u);
+				c.erase(11);
+				c.erase(0);
+				for (uint32 i = 0; i < 50; ++i)
+					EXPECT_EQ(c[i].value, i);
+
+				dynarray<tracked> copy(c);
+				dynarray<tracked> moved(std::move(c));
+				EXPECT_TRUE(c.isEmpty());
+				EXPECT_EQ(moved[49].value, 49u);
+				EXPECT_EQ(copy[49].value, 49u);
+				moved.shrink();
+				moved.popBack();
+				EXPECT_EQ(tracked::live, 99);
+			}
+			EXPECT_EQ(tracked::live, 0);
+
+			dynarray<std::unique_ptr<uint32>> owners;
+			for (uint32 i = 0; i < 20; ++i)
+				owners.pushBack(std::unique_ptr<uint32>(new uint32(i)));
+			owners.erase(5);
+			EXPECT_EQ(*owners[5], 6u);
+		}
+
+		TEST(dynarray, strings)
+		{
+			// strings are moved in and relocated on growth, never copied
+			cleanStats();
+			{
+				dynarray<coda::string_base<test_allocator>> c;
+				for (uint32 i = 0; i < 100; ++i)
+					c.pushBack(coda::string_base<test_allocator>("an element too long to be inline"));
+				c.insert(50, coda::string_base<test_allocator>("an inserted element too long to be inline"));
+				EXPECT_EQ(allocCounter + reallocCounter, 101u);
+				EXPECT_STREQ(c[50].c_str(), "an inserted element too long to be inline");
+				EXPECT_STREQ(c[100].c_str(), "an element too long to be inline");
+			}
+			EXPECT_EQ(releaseCounter, 101u);
+		}
+
+		TEST(smallarray, inlineStorage)
+		{
+			cleanStats();
+			{
+				coda::smallarray<uint32, 8, test_allocator> c;
+				for (uint32 i = 0; i < 8; ++i)
+					c.pushBack(i);
+				EXPECT_TRUE(c.isInline());
+				EXPECT_EQ(c.getCapacity(), 8u);
+				EXPECT_EQ(allocCounter + reallocCounter, 0u);
+
+				// spills on overflow and comes back when shrunk
+				for (uint32 i = 8; i < 20; ++i)
+					c.pushBack(c[0] + i);
+				EXPECT_FALSE(c.isInline());
+				EXPECT_GT(allocCounter, 0u);
+				EXPECT_EQ(c[19], 19u);
+				c.resize(5);
+				EXPECT_TRUE(c.isInline());
+				EXPECT_EQ(releaseCounter, allocCounter);
+				uint32 sum = 0;
+				for (uint32 value : c)
+					sum += value;
+				EXPECT_EQ(sum, 10u);
+
+				c.reserve(100);
+				EXPECT_FALSE(c.isInline());
+				EXPECT_EQ(c[4], 4u);
+				c.clear(true);
+				EXPECT_TRUE(c.isInline());
+			}
+			EXPECT_EQ(releaseCounter, allocCounter);
+		}
+
+		TEST(smallarray, moveElements)
+		{
+			{
+				coda::smallarray<tracked, 4> inlined;
+				for (uint32 i = 0; i < 3; ++i)
+					inlined.emplaceBack(i);
+				coda::smallarray<tracked, 4> spilled;
+				for (uint32 i = 0; i < 10; ++i)
+					spilled.emplaceBack(i);
+				spilled.insert(2, tracked(100));
+				spilled.erase(2);
+				EXPECT_EQ(tracked::live, 13);
+
+				// inline elements are moved one by one, heap storage is taken over
+				coda::smallarray<tracked, 4> a(std::move(inlined));
+				coda::smallarray<tracked, 4> b(std::move(spilled));
+				EXPECT_TRUE(inlined.isEmpty());
+				EXPECT_TRUE(spilled.isEmpty());
+				EXPECT_TRUE(a.isInline());
+				EXPECT_FALSE(b.isInline());
+				EXPECT_EQ(a[2].value, 2u);
+				EXPECT_EQ(b[9].value, 9u);
+				EXPECT_EQ(tracked::live, 13);
+
+				coda::smallarray<tracked, 4> copy(b);
+				copy = a;
+				EXPECT_EQ(copy.getSize(), 3u);
+				b = std::move(a);
+				EXPECT_TRUE(b.isInline());
+				EXPECT_EQ(b[1].value, 1u);
+				EXPECT_EQ(tracked::live, 6);
+			}
+			EXPECT_EQ(tracked::live, 0);
+
+			coda::smallarray<coda::string, 2> strings;
+			for (uint32 i = 0; i < 5; ++i)
+				strings.pushBack(coda::string("a string too long to be stored inline"));
+			strings.shrink();
+			EXPECT_STREQ(strings[4].c_str(), "a string too long to be stored inline");
+		}
+
+		TEST(soaarray, columns)
+		{
+			coda::soaarray<float, uint8, uint64> particles;
+			for (uint32 i = 0; i < 100; ++i)
+				particles.pushBack(static_cast<float>(i), static_cast<uint8>(i), static_cast<uint64>(i) * 1000);
+			EXPECT_EQ(particles.getSize(), 100u);
+			EXPECT_GE(particles.getCapacity(), 100u);
+			EXPECT_EQ(reinterpret_cast<uintptr_t>(particles.getData<0>()) % 64, 0u);
+			EXPECT_EQ(reinterpret_cast<uintptr_t>(particles.getData<1>()) % 64, 0u);
+			EXPECT_EQ(reinterpret_cast<uintptr_t>(particles.getData<2>()) % 64, 0u);
+
+			float sum = 0.f;
+			for (float x : particles.getColumn<0>())
+				sum += x;
+			EXPECT_FLOAT_EQ(sum, 4950.f);
+
+			coda::soaarray<float, uint8, uint64>::row row = particles[10];
+			EXPECT_EQ(row.get<1>(), 10u);
+			row.get<2>() = 7;
+			EXPECT_EQ(particles.getData<2>()[10], 7u);
+
+			particles.erase(0);
+			EXPECT_EQ(particles[0].get<2>(), 1000u);
+			particles.eraseSwap(0);
+			EXPECT_EQ(particles[0].get<1>(), 99u);
+			EXPECT_EQ(particles.getSize(), 98u);
+
+			// pushing a record of the array itself while it grows
+			particles.shrink();
+			particles.pushBack(particles[0].get<0>(), particles[0].get<1>(), particles[0].get<2>());
+			EXPECT_EQ(particles[98].get<1>(), 99u);
+
+			const coda::soaarray<float, uint8, uint64> copy(particles);
+			EXPECT_EQ(copy[98].get<2>(), 99000u);
+			coda::soaarray<float, uint8, uint64> moved(std::move(particles));
+			EXPECT_TRUE(particles.isEmpty());
+			EXPECT_EQ(moved.getColumn<1>().getSize(), 99u);
+		}
+
+		TEST(soaarray, objects)
+		{
+			{
+				coda::soaarray<tracked, coda::string> records;
+				records.reserve(2);
+				for (uint32 i = 0; i < 20; ++i)
+					records.pushBack(tracked(i), coda::string("a record name too long to be inline"));
+				records.pushBack();
+				EXPECT_EQ(tracked::live, 21);
+				records.popBack();
+				records.erase(3);
+				EXPECT_EQ(records[3].get<0>().value, 4u);
+				EXPECT_STREQ(records[19 - 1].get<1>().c_str(), "a record name too long to be inline");
+				records.resize(5);
+				EXPECT_EQ(tracked::live, 5);
+			}
+			EXPECT_EQ(tracked::live, 0);
+		}
+
+		TEST(dynarray, iterate)
+		{
+			dynarray<uint32> arr;
+			for (uint32 i = 0; i < 10; ++i)
+				arr.pushBack(9 - i);
+			std::sort(arr.begin(), arr.end());
+			uint32 expected = 0;
+			for (uint32 value : arr)
+				EXPECT_EQ(value, expected++);
+			EXPECT_EQ(arr.end() - arr.begin(), 10);
+
+			coda::starray<uint32, 8> st;
+			st.pushBack(3);
+			st.pushBack(4);
+			for (uint32& value : st)
+				value *= 2;
+			const coda::starray<uint32, 8>& cst = st;
+			EXPECT_EQ(std::accumulate(cst.begin(), cst.end(), 0u), 14u);
+		}
+
+		TEST(dynarray, span)
+		{
+			dynarray<uint32> arr;
+			for (uint32 i = 0; i < 10; ++i)
+				arr.pushBack(i);
+			uint32 sum = 0;
+			for (uint32 value : arr.getSpan())
+				sum += value;
+			EXPECT_EQ(sum, 45u);
+			arr.at_unchecked(3) = 30;
+			EXPECT_EQ(arr[3], 30u);
+
+			coda::span<const uint32> tail = static_cast<const dynarray<uint32>&>(arr).getSpan().getSubspan(8, 5);
+			EXPECT_EQ(tail.getSize(), 2u);
+			EXPECT_EQ(tail[0], 8u);
+			EXPECT_TRUE(arr.getSpan().getSubspan(10).isEmpty());
+
+			coda::starray<uint32, 4> st;
+			st.pushBack(1);
+			st.pushBack(2);
+			st[1] = 5;
+			EXPECT_EQ(st.at_unchecked(1), 5u);
+			EXPECT_EQ(st.getSpan().end() - st.getSpan().begin(), 2);
+
+			uint32 raw[3] = { 1, 2, 3 };
+			coda::span<uint32> rawSpan(raw);
+			EXPECT_EQ(rawSpan.getSize(), 3u);
+		}
+
 		/************************************************************************/
 		/* String tests                                                         */
 		/************************************************************************/
@@ -215,7 +531,8 @@ namespace coda
 			str = str2;
 			EXPECT_TRUE(str.isEmpty());
 			EXPECT_TRUE(str == str2);
-			EXPECT_TRUE(str.getCapacity() == 6);
+			// short strings keep the inline buffer
+			EXPECT_TRUE(str.getCapacity() == coda::string::inlineCapacity);
 		}
 
 		TEST(string, clear) {
@@ -252,6 +569,163 @@ namespace coda
 			EXPECT_FALSE(str1 == str2);
 		}
 
+		TEST(string, length)
+		{
+			coda::string str;
+			str.set("a string long enough to need the heap", 8);
+			EXPECT_STREQ(str.c_str(), "a string");
+			EXPECT_EQ(str.getLength(), 8u);
+			str = "a string long enough to need the heap";
+			EXPECT_EQ(str.getLength(), 37u);
+			coda::string copy(str);
+			EXPECT_EQ(copy.getLength(), 37u);
+			EXPECT_TRUE(copy == str);
+			// same length, different contents
+			copy = "a string long enough to need the hea!";
+			EXPECT_FALSE(copy == str);
+			copy = str;
+			copy = copy;
+			EXPECT_TRUE(copy == str);
+			str.clear();
+			EXPECT_EQ(str.getLength(), 0u);
+			EXPECT_TRUE(str.isEmpty());
+			str.setFmt("%d", 12345);
+			EXPECT_EQ(str.getLength(), 5u);
+		}
+
+		TEST(string, format)
+		{
+			cleanStats();
+			{
+				typedef coda::string_base<test_allocator> string;
+				string str;
+				str.setFmt("%s %d", "a line long enough to use the heap", 1);
+				EXPECT_STREQ(str.c_str(), "a line long enough to use the heap 1");
+				uint32 allocations = allocCounter + reallocCounter;
+				// fits in the current buffer, formatted in a single pass
+				str.setFmt("%s %d", "a line a bit shorter", 2);
+				EXPECT_STREQ(str.c_str(), "a line a bit shorter 2");
+				EXPECT_EQ(str.getLength(), 22u);
+				EXPECT_EQ(allocCounter + reallocCounter, allocations);
+
+				for (uint32 i = 0; i < 100; ++i)
+					str.appendFmt(",%u", i);
+				EXPECT_EQ(str.getLength(), 22u + 10 * 2 + 90 * 3);
+				EXPECT_EQ(strncmp(str.c_str() + 22, ",0,1,2", 6), 0);
+				// capacity grows geometrically
+				EXPECT_LE(allocCounter + reallocCounter, allocations + 4);
+
+				string inlineStr;
+				inlineStr.appendFmt("%d", 12);
+				inlineStr.appendFmt("%s", "345");
+				EXPECT_STREQ(inlineStr.c_str(), "12345");
+				EXPECT_TRUE(inlineStr.isInline());
+				inlineStr.appendFmt("%s", "6789abcdef0123456");
+				EXPECT_TRUE(inlineStr.isInline());
+				EXPECT_EQ(inlineStr.getLength(), 22u);
+				inlineStr.appendFmt("%s", "78");
+				EXPECT_STREQ(inlineStr.c_str(), "123456789abcdef012345678");
+				EXPECT_EQ(inlineStr.getLength(), 24u);
+			}
+
+			coda::string str;
+			str.format("{} items, {} ms, {}{}{} {{ok}}", 42, -3.5, true, 'x', coda::stringview("view"));
+			EXPECT_STREQ(str.c_str(), "42 items, -3.5 ms, truexview {ok}");
+			str.format("{}|{}|{}", uint64(18446744073709551615ull), int64(-9223372036854775807ll - 1), 0.1f);
+			EXPECT_STREQ(str.c_str(), "18446744073709551615|-9223372036854775808|0.1");
+			coda::string name("name");
+			str.format("{}: {}", name, "c string");
+			EXPECT_STREQ(str.c_str(), "name: c string");
+			str.format("no arguments");
+			EXPECT_STREQ(str.c_str(), "no arguments");
+		}
+
+		TEST(string, append)
+		{
+			cleanStats();
+			{
+				typedef coda::string_base<test_allocator> string;
+				string payload;
+				for (uint32 i = 0; i < 10000; ++i)
+					payload.append("0123456789", 10);
+				EXPECT_EQ(payload.getLength(), 100000u);
+				EXPECT_EQ(payload.c_str()[99999], '9');
+				// geometric growth
+				EXPECT_LE(allocCounter + reallocCounter, 20u);
+
+				string reserved;
+				reserved.reserve(1000);
+				EXPECT_GE(reserved.getCapacity(), 1001u);
+				uint32 allocations = allocCounter + reallocCounter;
+				for (uint32 i = 0; i < 1000; ++i)
+					reserved += 'a';
+				EXPECT_EQ(reserved.getLength(), 1000u);
+				EXPECT_EQ(allocCounter + reallocCounter, allocations);
+			}
+
+			coda::string str;
+			str.append("id=").append(42u).append(',').append(-7).append(',').append(2.5).append(',').append(false);
+			EXPECT_STREQ(str.c_str(), "id=42,-7,2.5,false");
+			str += coda::stringview(" tail");
+			EXPECT_STREQ(str.c_str(), "id=42,-7,2.5,false tail");
+
+			// appending a string to itself, inline and on the heap
+			coda::string self("0123456789abcdef");
+			self += self;
+			EXPECT_STREQ(self.c_str(), "0123456789abcdef0123456789abcdef");
+			self += self;
+			EXPECT_EQ(self.getLength(), 64u);
+			EXPECT_STREQ(self.c_str() + 48, "0123456789abcdef");
+
+			coda::string joined = coda::string("a") + "b" + 'c' + 1;
+			EXPECT_STREQ(joined.c_str(), "abc1");
+		}
+
+		TEST(string, inlineStorage)
+		{
+			static_assert(sizeof(coda::string) == 24, "");
+			cleanStats();
+			{
+				typedef coda::string_base<test_allocator> string;
+				string shortStr("short");
+				EXPECT_TRUE(shortStr.isInline());
+				EXPECT_GE(shortStr.c_str(), reinterpret_cast<const char*>(&shortStr));
+				EXPECT_LT(shortStr.c_str(), reinterpret_cast<const char*>(&shortStr + 1));
+
+				// 23 characters still fit, the terminator shares the mode byte
+				string full("0123456789abcdef0123456");
+				EXPECT_TRUE(full.isInline());
+				EXPECT_EQ(full.getLength(), 23u);
+				EXPECT_STREQ(full.c_str(), "0123456789abcdef0123456");
+				EXPECT_EQ(allocCounter + reallocCounter, 0u);
+
+				string moved(std::move(full));
+				EXPECT_STREQ(moved.c_str(), "0123456789abcdef0123456");
+				EXPECT_EQ(full.c_str(), nullptr);
+
+				// grows to the heap keeping the contents, and stays there
+				moved.setFmt("%s and %d more", "0123456789abcdef0123456", 42);
+				EXPECT_FALSE(moved.isInline());
+				EXPECT_STREQ(moved.c_str(), "0123456789abcdef0123456 and 42 more");
+				EXPECT_EQ(moved.getLength(), 35u);
+				moved = "short";
+				EXPECT_FALSE(moved.isInline());
+				EXPECT_TRUE(moved == shortStr);
+				EXPECT_EQ(allocCounter + reallocCounter, 1u);
+
+				coda::hashtable<string, uint32> h(64);
+				for (uint32 i = 0; i < 50; ++i)
+				{
+					string key;
+					key.setFmt("key%u", i);
+					h.createItem(key, i);
+				}
+				EXPECT_EQ(*h.findItem(string("key42")), 42u);
+				EXPECT_EQ(allocCounter + reallocCounter, 1u);
+			}
+			EXPECT_EQ(releaseCounter, 1u);
+		}
+
 		/************************************************************************/
 		/* Hash function test                                                   */
 		/************************************************************************/
@@ -281,6 +755,1081 @@ namespace coda
 				EXPECT_TRUE(h.findItem(i) == p);
 			}
 		}
+
+		TEST(hashtable, destroy)
+		{
+			static constexpr uint32 Count = 1000;
+			coda::hashtable<uint32, uint32> h(Count);
+			for (uint32 i = 0; i < Count; ++i)
+				h.createItem(i, i * 2);
+			EXPECT_EQ(h.getCount(), Count);
+
+			for (uint32 i = 0; i < Count; i += 2)
+				h.destroyItem(i);
+			EXPECT_EQ(h.getCount(), Count / 2);
+			for (uint32 i = 0; i < Count; ++i)
+			{
+				uint32* p = h.findItem(i);
+				if (i & 1)
+				{
+					ASSERT_TRUE(p != nullptr);
+					EXPECT_EQ(*p, i * 2);
+				}
+				else
+				{
+					EXPECT_TRUE(p == nullptr);
+				}
+			}
+
+			// released entries and deleted slots are reused
+			for (uint32 round = 0; round < 8; ++round)
+			{
+				for (uint32 i = 0; i < Count; i += 2)
+					h.createItem(i + Count * (round + 1), i);
+				for (uint32 i = 0; i < Count; i += 2)
+					h.destroyItem(i + Count * (round + 1));
+			}
+			EXPECT_EQ(h.getCount(), Count / 2);
+			EXPECT_FALSE(h.contains(0));
+			EXPECT_TRUE(h.contains(1));
+		}
+
+		TEST(hashtable, stableId)
+		{
+			coda::hashtable<uint32, uint32> h(64);
+			h.createItem(7, 70);
+			coda::hashtableitemid id = h.findId(7);
+			uint32* p = h.getById(id);
+			for (uint32 i = 100; i < 150; ++i)
+				h.createItem(i, i);
+			for (uint32 i = 100; i < 150; i += 3)
+				h.destroyItem(i);
+			EXPECT_TRUE(h.getById(id) == p);
+			EXPECT_EQ(h.findId(7).itemId, id.itemId);
+			h.destroyItem(7);
+			EXPECT_TRUE(h.getById(id) == nullptr);
+			EXPECT_EQ(h.findId(7).id, (coda::uint64)coda::hashtable_invalidId);
+		}
+
+		TEST(hashtable, grow)
+		{
+			static constexpr uint32 Count = 100000;
+			coda::hashtable<uint32, uint32> h(16);
+			h.createItem(0, 0);
+			uint32* first = h.findItem(0);
+			coda::hashtableitemid firstId = h.findId(0);
+			bool rehashed = false;
+			for (uint32 i = 1; i < Count; ++i)
+			{
+				h.createItem(i, i);
+				rehashed |= h.isRehashing();
+				EXPECT_LE(h.getLoadFactor(), h.getMaxLoadFactor());
+				// items must be reachable while the index is being migrated
+				if (h.isRehashing())
+				{
+					ASSERT_TRUE(h.contains(i / 2));
+					ASSERT_TRUE(h.contains(i));
+				}
+			}
+			EXPECT_TRUE(rehashed);
+			EXPECT_EQ(h.getCount(), Count);
+			EXPECT_GE(h.getSize(), Count);
+			EXPECT_TRUE(h.getById(firstId) == first);
+			for (uint32 i = 0; i < Count; ++i)
+			{
+				uint32* p = h.findItem(i);
+				ASSERT_TRUE(p != nullptr);
+				EXPECT_EQ(*p, i);
+			}
+			for (uint32 i = 0; i < Count; i += 2)
+				h.destroyItem(i);
+			for (uint32 i = 0; i < Count; ++i)
+				ASSERT_EQ(h.contains(i), (i & 1) != 0);
+			h.finishRehash();
+			EXPECT_FALSE(h.isRehashing());
+		}
+
+		TEST(hashtable, loadFactor)
+		{
+			coda::hashtable<uint32, uint32> h(100, 0.5f);
+			EXPECT_EQ(h.getMaxLoadFactor(), 0.5f);
+			EXPECT_EQ(h.getLoadFactor(), 0.f);
+			for (uint32 i = 0; i < h.getBucketCount() / 4; ++i)
+				h.createItem(i, i);
+			EXPECT_FLOAT_EQ(h.getLoadFactor(), 0.25f);
+			uint32 buckets = h.getBucketCount();
+			while (h.getCount() <= buckets / 2)
+				h.createItem(h.getCount(), 0);
+			EXPECT_EQ(h.getBucketCount(), buckets * 2);
+			EXPECT_LE(h.getLoadFactor(), 0.5f);
+		}
+
+		TEST(hashtable, groupProbe)
+		{
+			static constexpr uint32 Count = 20000;
+			const coda::cpufeatures detected = coda::getCpuFeatures();
+			coda::cpufeatures levels[3];
+			levels[1].sse2 = true;
+			levels[2].sse2 = true;
+			levels[2].avx2 = true;
+
+			// build and query with every dispatch level, the probe sequence must not depend on it
+			for (const coda::cpufeatures& build : levels)
+			{
+				coda::setCpuFeatures(build);
+				coda::hashtable<uint32, uint32> h(64, 0.9f);
+				for (uint32 i = 0; i < Count; ++i)
+					h.createItem(i * 7919, i);
+				for (uint32 i = 0; i < Count; i += 3)
+					h.destroyItem(i * 7919);
+
+				for (const coda::cpufeatures& query : levels)
+				{
+					coda::setCpuFeatures(query);
+					for (uint32 i = 0; i < Count; ++i)
+					{
+						uint32* p = h.findItem(i * 7919);
+						if (i % 3)
+						{
+							ASSERT_TRUE(p != nullptr);
+							EXPECT_EQ(*p, i);
+						}
+						else
+						{
+							ASSERT_TRUE(p == nullptr);
+						}
+						ASSERT_FALSE(h.contains(i * 7919 + 1));
+					}
+				}
+			}
+			coda::setCpuFeatures(detected);
+		}
+
+		TEST(hash, strings)
+		{
+			// anagrams and short keys used to collide with the byte sum
+			EXPECT_NE(coda::hash_function("ab"), coda::hash_function("ba"));
+			EXPECT_NE(coda::hash_function("listen"), coda::hash_function("silent"));
+			EXPECT_NE(coda::hash_function(""), coda::hash_function("a"));
+
+			coda::string str("Hello world, this is a longer key that takes the 48 byte loop");
+			EXPECT_EQ(coda::hash_function(str), coda::hash_function(str.c_str()));
+			EXPECT_EQ(coda::hash_function(coda::string()), coda::hash_function(""));
+
+			// every length goes through a different read pattern
+			char buffer[128];
+			memset(buffer, 'x', sizeof(buffer));
+			coda::hashtable<coda::uint64, uint32> seen(256);
+			for (uint32 i = 0; i < sizeof(buffer); ++i)
+			{
+				coda::uint64 h = coda::hashBytes(buffer, i);
+				EXPECT_FALSE(seen.contains(h));
+				seen.createItem(h, i);
+			}
+		}
+
+		TEST(hash, integers)
+		{
+			EXPECT_EQ(coda::hash_function(5), coda::hash_function(5ull));
+			EXPECT_EQ(coda::hash_function(-1), coda::hash_function(-1ll));
+			EXPECT_NE(coda::hash_function(1u), coda::hash_function(2u));
+			EXPECT_EQ(coda::hash_function(0.f), coda::hash_function(-0.f));
+
+			// sequential keys spread evenly over the low bits
+			static constexpr uint32 Buckets = 256;
+			static constexpr uint32 Count = Buckets * 64;
+			uint32 histogram[Buckets] = {};
+			for (uint32 i = 0; i < Count; ++i)
+				++histogram[coda::hash_function(i) & (Buckets - 1)];
+			for (uint32 i = 0; i < Buckets; ++i)
+			{
+				EXPECT_GT(histogram[i], 24u);
+				EXPECT_LT(histogram[i], 104u);
+			}
+		}
+
+		TEST(hashtable, stringKeys)
+		{
+			coda::hashtable<coda::string, uint32> h(16);
+			char key[32];
+			for (uint32 i = 0; i < 1000; ++i)
+			{
+				snprintf(key, sizeof(key), "key%u", i);
+				h.createItem(coda::string(key), i);
+			}
+			for (uint32 i = 0; i < 1000; ++i)
+			{
+				snprintf(key, sizeof(key), "key%u", i);
+				uint32* p = h.findItem(coda::string(key));
+				ASSERT_TRUE(p != nullptr);
+				EXPECT_EQ(*p, i);
+			}
+			EXPECT_FALSE(h.contains(coda::string("key1000")));
+		}
+
+		TEST(hashtable, iterate)
+		{
+			coda::hashtable<uint32, uint32> h(16);
+			EXPECT_TRUE(h.begin() == h.end());
+			for (uint32 i = 0; i < 1000; ++i)
+				h.createItem(i, i * 2);
+			for (uint32 i = 0; i < 1000; i += 3)
+				h.destroyItem(i);
+
+			uint32 visited = 0;
+			uint64 keySum = 0;
+			for (auto [key, item] : h)
+			{
+				EXPECT_EQ(item, key * 2);
+				keySum += key;
+				++visited;
+			}
+			EXPECT_EQ(visited, h.getCount());
+			uint64 expectedSum = 0;
+			for (uint32 i = 0; i < 1000; ++i)
+				expectedSum += i % 3 ? i : 0;
+			EXPECT_EQ(keySum, expectedSum);
+
+			// items are writable and the table works with <algorithm>
+			for (auto entry : h)
+				entry.item += 1;
+			const coda::hashtable<uint32, uint32>& ch = h;
+			EXPECT_EQ(std::count_if(ch.begin(), ch.end(), [](auto entry) { return entry.item % 2 == 1; }), static_cast<std::ptrdiff_t>(h.getCount()));
+			coda::hashtable<uint32, uint32>::const_iterator found = std::find_if(ch.begin(), ch.end(), [](auto entry) { return entry.key == 500; });
+			ASSERT_TRUE(found != ch.end());
+			EXPECT_EQ(found->item, 1001u);
+
+			// sweep erasing while iterating
+			for (coda::hashtable<uint32, uint32>::iterator it = h.begin(); it != h.end();)
+			{
+				if (it.getKey() % 2)
+					it = h.erase(it);
+				else
+					++it;
+			}
+			for (auto entry : h)
+				EXPECT_EQ(entry.key % 2, 0u);
+			EXPECT_EQ(static_cast<uint32>(std::distance(h.begin(), h.end())), h.getCount());
+			EXPECT_FALSE(h.contains(1u));
+			EXPECT_TRUE(h.contains(2u));
+		}
+
+		TEST(hashtable, eraseWhileIterating)
+		{
+			// erase destroys the entry of the iterator even when its key repeats
+			coda::hashtable<uint32, uint32> h(16);
+			h.createItem(5, 100);
+			h.createItem(5, 200);
+			h.createItem(6, 300);
+			coda::hashtable<uint32, uint32>::iterator it = h.begin();
+			while (it.getItem() != 200)
+				++it;
+			it = h.erase(it);
+			ASSERT_TRUE(it != h.end());
+			EXPECT_EQ(it.getItem(), 300u);
+			EXPECT_EQ(h.getCount(), 2u);
+			EXPECT_EQ(*h.findItem(5u), 100u);
+			uint32 itemSum = 0;
+			for (auto entry : h)
+				itemSum += entry.item;
+			EXPECT_EQ(itemSum, 400u);
+
+			// items destroyed ahead of the iterator are skipped
+			coda::hashtable<uint32, uint32> sweep(16);
+			for (uint32 i = 0; i < 10; ++i)
+				sweep.createItem(i, i);
+			uint32 visited = 0;
+			for (auto entry : sweep)
+			{
+				if (entry.key == 0)
+				{
+					for (uint32 i = 1; i < 10; ++i)
+						sweep.destroyItem(i);
+				}
+				++visited;
+			}
+			EXPECT_EQ(visited, 1u);
+			EXPECT_EQ(sweep.getCount(), 1u);
+
+			// same while the index grows, erasing every other item through the old index
+			coda::hashtable<uint32, uint32> growing(1000);
+			uint32 created = 0;
+			while (!growing.isRehashing())
+			{
+				growing.createItem(created % 900, created);
+				++created;
+			}
+			for (it = growing.begin(); it != growing.end();)
+			{
+				if (it.getItem() >= 900)
+					it = growing.erase(it);
+				else
+					++it;
+			}
+			EXPECT_FALSE(growing.isRehashing());
+			EXPECT_EQ(growing.getCount(), 900u);
+			for (auto entry : growing)
+				EXPECT_EQ(entry.key, entry.item);
+		}
+
+		TEST(hashtable, heterogeneousLookup)
+		{
+			typedef coda::string_base<test_allocator> string;
+			static const char* prefix = "a key long enough for the heap #";
+			coda::hashtable<string, uint32> h(16);
+			char key[64];
+			for (uint32 i = 0; i < 100; ++i)
+			{
+				snprintf(key, sizeof(key), "%s%u", prefix, i);
+				h.createItem(string(key), i);
+			}
+
+			// tokens are looked up straight from the input buffer
+			cleanStats();
+			const char* input = "a key long enough for the heap #42 a key long enough for the heap #7 a key long enough for the heap #100";
+			coda::stringview view(input);
+			uint32* p = h.findItem(view.getSubstring(0, 34));
+			ASSERT_TRUE(p != nullptr);
+			EXPECT_EQ(*p, 42u);
+			EXPECT_TRUE(h.contains(view.getSubstring(35, 33)));
+			EXPECT_FALSE(h.contains(view.getSubstring(69)));
+			EXPECT_EQ(*h.findItem("a key long enough for the heap #7"), 7u);
+			snprintf(key, sizeof(key), "%s%u", prefix, 99);
+			EXPECT_TRUE(h.getById(h.findId(static_cast<char*>(key))) != nullptr);
+			EXPECT_EQ(allocCounter + reallocCounter, 0u);
+
+			string stored(key);
+			EXPECT_TRUE(stored == coda::stringview(key));
+			EXPECT_TRUE(stored == key);
+			EXPECT_EQ(coda::hash_function(coda::stringview(key)), coda::hash_function(stored));
+			EXPECT_TRUE(coda::stringview(stored) == coda::stringview(key, stored.getLength()));
+			EXPECT_STREQ(string(view.getSubstring(0, 5)).c_str(), "a key");
+		}
+
+		TEST(stringinterner, intern)
+		{
+			coda::stringinterner interner(16, 256);
+			coda::symbol a = interner.intern("position");
+			coda::symbol b = interner.intern("velocity");
+			EXPECT_EQ(a.id, 0u);
+			EXPECT_EQ(b.id, 1u);
+			EXPECT_TRUE(interner.intern(coda::stringview("position.x", 8)) == a);
+			EXPECT_TRUE(interner.find("velocity") == b);
+			EXPECT_FALSE(interner.find("mass").isValid());
+			EXPECT_STREQ(interner.c_str(a), "position");
+			EXPECT_EQ(interner.getString(b).getLength(), 8u);
+			EXPECT_EQ(interner.getStorageBytes(), 18u);
+
+			// spans several blocks, and strings longer than a block
+			char name[32];
+			for (uint32 i = 0; i < 1000; ++i)
+			{
+				snprintf(name, sizeof(name), "symbol%u", i);
+				EXPECT_EQ(interner.intern(name).id, i + 2);
+			}
+			char longName[1001];
+			memset(longName, 'x', 1000);
+			longName[1000] = 0;
+			coda::symbol big = interner.intern(longName);
+			EXPECT_EQ(interner.getString(big).getLength(), 1000u);
+			EXPECT_STREQ(interner.c_str(a), "position");
+			EXPECT_STREQ(interner.c_str(interner.find("symbol999")), "symbol999");
+			EXPECT_EQ(interner.getCount(), 1003u);
+			EXPECT_TRUE(interner.intern("").isValid());
+		}
+
+		TEST(stringinterner, concurrent)
+		{
+			coda::concurrentstringinterner interner;
+			static constexpr uint32 ThreadCount = 8;
+			static constexpr uint32 NameCount = 2000;
+			std::vector<std::thread> threads;
+			std::vector<std::vector<coda::symbol>> symbols(ThreadCount, std::vector<coda::symbol>(NameCount));
+			for (uint32 t = 0; t < ThreadCount; ++t)
+				threads.emplace_back([&interner, &symbols, t]()
+					{
+						char name[32];
+						for (uint32 i = 0; i < NameCount; ++i)
+						{
+							snprintf(name, sizeof(name), "name%u", (i * 7 + t) % NameCount);
+							symbols[t][(i * 7 + t) % NameCount] = interner.intern(name);
+						}
+					});
+			for (std::thread& thread : threads)
+				thread.join();
+			EXPECT_EQ(interner.getCount(), NameCount);
+			// every thread got the same symbol for the same string
+			for (uint32 t = 1; t < ThreadCount; ++t)
+				for (uint32 i = 0; i < NameCount; ++i)
+					EXPECT_TRUE(symbols[t][i] == symbols[0][i]);
+
+			interner.freeze();
+			EXPECT_TRUE(interner.isFrozen());
+			EXPECT_FALSE(interner.intern("unknown").isValid());
+			EXPECT_TRUE(interner.intern("name42") == symbols[0][42]);
+			EXPECT_STREQ(interner.c_str(symbols[3][1999]), "name1999");
+		}
+
+		TEST(concurrenthashtable, basic)
+		{
+			coda::concurrenthashtable<uint32, uint32> h(64, 4);
+			EXPECT_EQ(h.getShardCount(), 4u);
+			EXPECT_TRUE(h.createItem(1, 10));
+			EXPECT_FALSE(h.createItem(1, 20));
+			uint32 value = 0;
+			EXPECT_TRUE(h.findItem(1, value));
+			EXPECT_EQ(value, 10u);
+			EXPECT_TRUE(h.updateItem(1, [](uint32& item) { item += 5; }));
+			EXPECT_TRUE(h.visitItem(1, [&value](const uint32& item) { value = item; }));
+			EXPECT_EQ(value, 15u);
+			EXPECT_FALSE(h.findItem(2, value));
+			EXPECT_TRUE(h.destroyItem(1));
+			EXPECT_FALSE(h.destroyItem(1));
+			EXPECT_EQ(h.getCount(), 0u);
+		}
+
+		TEST(concurrenthashtable, stress)
+		{
+			static constexpr uint32 ThreadCount = 8;
+			static constexpr uint32 KeysPerThread = 20000;
+			static constexpr uint32 StableKeys = 1000;
+			coda::concurrenthashtable<uint32, uint32> h(16, 16);
+
+			// stable keys are read by everyone while writers churn their own ranges
+			for (uint32 i = 0; i < StableKeys; ++i)
+				h.createItem(i, i * 3);
+
+			std::atomic<uint32> failures(0);
+			std::vector<std::thread> threads;
+			for (uint32 t = 0; t < ThreadCount; ++t)
+			{
+				threads.emplace_back([&h, &failures, t]()
+					{
+						const uint32 base = StableKeys + t * KeysPerThread;
+						for (uint32 i = 0; i < KeysPerThread; ++i)
+						{
+							if (!h.createItem(base + i, t))
+								++failures;
+							uint32 value = 0;
+							uint32 stable = (i * 7) % StableKeys;
+							if (!h.findItem(stable, value) || value != stable * 3)
+								++failures;
+							// drop every other key again to exercise tombstones and rehashes
+							if (i & 1)
+							{
+								if (!h.destroyItem(base + i - 1))
+									++failures;
+							}
+						}
+						for (uint32 i = 0; i < KeysPerThread; ++i)
+						{
+							uint32 value = ~0u;
+							bool found = h.findItem(base + i, value);
+							if (found != ((i & 1) != 0) || (found && value != t))
+								++failures;
+						}
+					});
+			}
+			for (std::thread& thread : threads)
+				thread.join();
+
+			EXPECT_EQ(failures.load(), 0u);
+			EXPECT_EQ(h.getCount(), StableKeys + ThreadCount * KeysPerThread / 2);
+		}
+
+		/************************************************************************/
+		/* Allocator tests                                                      */
+		/************************************************************************/
+
+		TEST(arena, allocate)
+		{
+			coda::arena a(1024);
+			void* p0 = a.allocate(3);
+			void* p1 = a.allocate(40);
+			EXPECT_EQ(reinterpret_cast<uintptr_t>(p0) % coda::arena::alignment, 0u);
+			EXPECT_EQ(reinterpret_cast<uintptr_t>(p1) % coda::arena::alignment, 0u);
+			EXPECT_NE(p0, p1);
+
+			// the last block grows and shrinks in place
+			memset(p1, 0xab, 40);
+			EXPECT_EQ(a.reallocate(p1, 200), p1);
+			EXPECT_EQ(a.reallocate(p1, 8), p1);
+			void* p2 = a.allocate(8);
+			EXPECT_EQ(static_cast<coda::byte*>(p2) - static_cast<coda::byte*>(p1), 32);
+
+			// other blocks are copied
+			memset(p0, 0x12, 3);
+			void* p3 = a.reallocate(p0, 64);
+			EXPECT_NE(p3, p0);
+			EXPECT_EQ(static_cast<coda::byte*>(p3)[2], 0x12);
+
+			// releasing the last block gives its memory back
+			size_t used = a.getUsedBytes();
+			void* p4 = a.allocate(100);
+			a.release(p4);
+			EXPECT_EQ(a.getUsedBytes(), used);
+
+			// oversized blocks get their own chunk
+			void* big = a.allocate(4096);
+			memset(big, 0, 4096);
+			EXPECT_GE(a.getReservedBytes(), 4096u + 1024u);
+
+			a.reset();
+			EXPECT_EQ(a.getUsedBytes(), 0u);
+			EXPECT_LT(a.getReservedBytes(), 4096u + 1024u);
+		}
+
+		TEST(arena, containers)
+		{
+			struct requesttag {};
+			typedef coda::arenaallocator<requesttag> allocator;
+			{
+				coda::hashtable<uint32, uint32, allocator> h(16);
+				for (uint32 i = 0; i < 1000; ++i)
+					h.createItem(i, i);
+				EXPECT_EQ(*h.findItem(999), 999u);
+
+				coda::string_base<allocator> str("temporary");
+				str = "a longer temporary string";
+				EXPECT_STREQ(str.c_str(), "a longer temporary string");
+			}
+			EXPECT_GT(allocator::getArena().getUsedBytes(), 0u);
+			allocator::reset();
+			EXPECT_EQ(allocator::getArena().getUsedBytes(), 0u);
+		}
+
+		TEST(pool, allocate)
+		{
+			EXPECT_EQ(poolallocator::getSizeClass(1), 0u);
+			EXPECT_EQ(poolallocator::getSizeClass(16), 0u);
+			EXPECT_EQ(poolallocator::getSizeClass(17), 1u);
+			EXPECT_EQ(poolallocator::getClassSize(poolallocator::getSizeClass(200)), 256u);
+			EXPECT_EQ(poolallocator::getSizeClass(poolallocator::maxPooledSize), poolallocator::sizeClassCount - 1);
+
+			void* p0 = poolallocator::allocate(24);
+			EXPECT_EQ(reinterpret_cast<uintptr_t>(p0) % 16, 0u);
+			EXPECT_EQ(poolallocator::getBlockSize(p0), 32u);
+			memset(p0, 0xab, 24);
+			// released blocks are handed out again first
+			poolallocator::release(p0);
+			void* p1 = poolallocator::allocate(32);
+			EXPECT_EQ(p0, p1);
+
+			// grows in place within the class, moves and keeps the contents across classes
+			EXPECT_EQ(poolallocator::reallocate(p1, 30), p1);
+			memcpy(p1, "pooled", 7);
+			void* p2 = poolallocator::reallocate(p1, 300);
+			EXPECT_STREQ(static_cast<const char*>(p2), "pooled");
+			void* p3 = poolallocator::reallocate(p2, 4096);
+			EXPECT_STREQ(static_cast<const char*>(p3), "pooled");
+			EXPECT_EQ(poolallocator::getBlockSize(p3), 4096u);
+			poolallocator::release(p3);
+			poolallocator::release(nullptr);
+		}
+
+		TEST(pool, threads)
+		{
+			// blocks released by another thread than the one that allocated them
+			std::vector<void*> blocks(4096);
+			std::thread producer([&blocks]()
+				{
+					for (size_t i = 0; i < blocks.size(); ++i)
+					{
+						blocks[i] = poolallocator::allocate(8 + i % 256);
+						memset(blocks[i], static_cast<int>(i), 8);
+					}
+				});
+			producer.join();
+			std::vector<std::thread> consumers;
+			for (size_t t = 0; t < 4; ++t)
+				consumers.emplace_back([&blocks, t]()
+					{
+						for (size_t i = t; i < blocks.size(); i += 4)
+						{
+							EXPECT_EQ(static_cast<byte*>(blocks[i])[7], static_cast<byte>(i));
+							poolallocator::release(blocks[i]);
+							void* p = poolallocator::allocate(64);
+							poolallocator::release(p);
+						}
+					});
+			for (std::thread& consumer : consumers)
+				consumer.join();
+		}
+
+		TEST(pool, containers)
+		{
+			coda::hashtable<uint32, uint32, coda::poolallocator> h(16);
+			for (uint32 i = 0; i < 10000; ++i)
+				h.createItem(i, i * 3);
+			for (uint32 i = 0; i < 10000; i += 2)
+				h.destroyItem(i);
+			EXPECT_EQ(h.getCount(), 5000u);
+			EXPECT_EQ(*h.findItem(9999), 29997u);
+
+			coda::string_base<coda::poolallocator> str("small");
+			str = "a string that moves to a bigger size class";
+			EXPECT_STREQ(str.c_str(), "a string that moves to a bigger size class");
+		}
+
+		// stateful allocator, every container using it reports to its own counters
+		class counting_allocator
+		{
+		public:
+			counting_allocator(uint32* _counter) : counter(_counter) {}
+
+			void* allocate(size_t size) { ++*counter; return baseallocator::allocate(size); }
+			void* reallocate(void* p, size_t size) { if (!p) ++*counter; return baseallocator::reallocate(p, size); }
+			void release(void* p) { if (p) --*counter; baseallocator::release(p); }
+
+		private:
+			uint32* counter;
+		};
+
+		TEST(allocator, stateful)
+		{
+			// stateless allocators take no space
+			static_assert(sizeof(dynarray<uint32>) == sizeof(dynarray<uint32, test_allocator>), "");
+			static_assert(sizeof(coda::string) == sizeof(coda::string_base<test_allocator>), "");
+			static_assert(sizeof(dynarray<uint32, counting_allocator>) == sizeof(dynarray<uint32>) + sizeof(void*), "");
+
+			uint32 liveA = 0;
+			uint32 liveB = 0;
+			{
+				dynarray<uint32, counting_allocator> a(16, counting_allocator(&liveA));
+				coda::string_base<counting_allocator> b("allocated by b, too long to be inline", counting_allocator(&liveB));
+				coda::hashtable<uint32, uint32, counting_allocator> h(16, 0.875f, counting_allocator(&liveB));
+				for (uint32 i = 0; i < 100; ++i)
+					h.createItem(i, i);
+				EXPECT_EQ(liveA, 1u);
+				EXPECT_GT(liveB, 1u);
+
+				// moved strings keep the allocator their buffer came from
+				coda::string_base<counting_allocator> c(std::move(b));
+				EXPECT_STREQ(c.c_str(), "allocated by b, too long to be inline");
+				coda::string_base<counting_allocator> d("allocated by a, too long to be inline", counting_allocator(&liveA));
+				EXPECT_EQ(liveA, 2u);
+				d = std::move(c);
+				EXPECT_EQ(liveA, 1u);
+			}
+			EXPECT_EQ(liveA, 0u);
+			EXPECT_EQ(liveB, 0u);
+		}
+
+		TEST(allocator, arenaref)
+		{
+			coda::arena requestArena;
+			{
+				coda::hashtable<uint32, uint32, coda::arenaref> h(16, 0.875f, coda::arenaref(requestArena));
+				coda::string_base<coda::arenaref> str("request scoped", coda::arenaref(requestArena));
+				for (uint32 i = 0; i < 100; ++i)
+					h.createItem(i, i);
+				EXPECT_EQ(&h.getAllocator().getResource(), &requestArena);
+				EXPECT_STREQ(str.c_str(), "request scoped");
+			}
+			EXPECT_GT(requestArena.getUsedBytes(), 0u);
+			requestArena.reset();
+			EXPECT_EQ(requestArena.getUsedBytes(), 0u);
+		}
+
+		TEST(allocator, tracking)
+		{
+			struct trackedtag {};
+			typedef coda::trackingallocator<coda::baseallocator, trackedtag> allocator;
+			allocator::getStats().reset();
+			{
+				coda::hashtable<uint32, uint32, allocator> h(16);
+				for (uint32 i = 0; i < 1000; ++i)
+					h.createItem(i, i);
+				coda::string_base<allocator> str("tracked");
+				str = "tracked and reallocated";
+
+				coda::allocationsnapshot snapshot = allocator::getStats().getSnapshot();
+#if CODA_ALLOCATION_TRACKING
+				EXPECT_GT(snapshot.allocations, 2u);
+				EXPECT_GT(snapshot.liveBytes, 1000u * 2 * sizeof(uint32));
+				EXPECT_GE(snapshot.peakBytes, snapshot.liveBytes);
+				uint64 histogramTotal = 0;
+				for (uint64 count : snapshot.histogram)
+					histogramTotal += count;
+				EXPECT_EQ(histogramTotal, snapshot.allocations + snapshot.reallocations);
+#else
+				EXPECT_EQ(snapshot.allocations, 0u);
+#endif
+			}
+			coda::allocationsnapshot snapshot = allocator::getStats().getSnapshot();
+			EXPECT_EQ(snapshot.liveBytes, 0u);
+			EXPECT_EQ(snapshot.releases, snapshot.allocations);
+#if CODA_ALLOCATION_TRACKING
+			EXPECT_GT(snapshot.peakBytes, 0u);
+#else
+			EXPECT_EQ(snapshot.peakBytes, 0u);
+#endif
+			EXPECT_EQ(coda::allocationstats::getHistogramBucket(0), 0u);
+			EXPECT_EQ(coda::allocationstats::getHistogramBucket(64), 6u);
+			EXPECT_EQ(coda::allocationstats::getHistogramBucket(100), 6u);
+		}
+
+		TEST(allocator, trackingSites)
+		{
+			uint32 live = 0;
+			typedef coda::trackingallocator<counting_allocator> allocator;
+			coda::allocationtag* entities = CODA_ALLOCATION_SITE("entities");
+			coda::allocationtag* names = CODA_ALLOCATION_SITE("names");
+			{
+				coda::hashtable<uint32, uint32, allocator> h(16, 0.875f, allocator(entities, counting_allocator(&live)));
+				coda::string_base<allocator> str("entity name, too long to be inline", allocator(names, counting_allocator(&live)));
+				for (uint32 i = 0; i < 100; ++i)
+					h.createItem(i, i);
+				EXPECT_GT(live, 1u);
+#if CODA_ALLOCATION_TRACKING
+				EXPECT_GT(entities->getStats().getSnapshot().liveBytes, 100u * 2 * sizeof(uint32));
+				EXPECT_EQ(names->getStats().getSnapshot().liveBytes, str.getCapacity());
+#endif
+			}
+			EXPECT_EQ(live, 0u);
+#if CODA_ALLOCATION_TRACKING
+			EXPECT_EQ(entities->getStats().getSnapshot().liveBytes, 0u);
+			EXPECT_EQ(names->getStats().getSnapshot().allocations, 1u);
+
+			// sites are registered once and can be listed
+			uint32 found = 0;
+			for (coda::allocationtag* tag = coda::allocationtag::getFirst(); tag; tag = tag->getNext())
+				found += tag == entities || tag == names;
+			EXPECT_EQ(found, 2u);
+			EXPECT_STREQ(names->getName(), "names");
+#else
+			EXPECT_TRUE(entities == nullptr && names == nullptr);
+#endif
+		}
+
+		struct alignas(64) paddedcounter
+		{
+			uint64 value;
+		};
+
+		static bool isAligned(const void* p, size_t alignment)
+		{
+			return (reinterpret_cast<uintptr_t>(p) & (alignment - 1)) == 0;
+		}
+
+		TEST(allocator, aligned)
+		{
+			byte* p = static_cast<byte*>(baseallocator::allocate(100, 256));
+			EXPECT_TRUE(isAligned(p, 256));
+			for (uint32 i = 0; i < 100; ++i)
+				p[i] = static_cast<byte>(i);
+			p = static_cast<byte*>(baseallocator::reallocate(p, 100000, 256));
+			EXPECT_TRUE(isAligned(p, 256));
+			EXPECT_EQ(p[99], 99);
+			baseallocator::release(p);
+
+			coda::arena blockArena(1024);
+			void* small = blockArena.allocate(8);
+			void* aligned = blockArena.allocate(8, 128);
+			EXPECT_TRUE(isAligned(aligned, 128));
+			EXPECT_TRUE(isAligned(blockArena.allocate(2000, 512), 512));
+			EXPECT_TRUE(isAligned(blockArena.reallocate(small, 100, 64), 64));
+
+			// over-aligned elements, counting_allocator has no alignment overloads and gets padded blocks
+			uint32 live = 0;
+			{
+				dynarray<paddedcounter, counting_allocator> counters{ counting_allocator(&live) };
+				coda::hashtable<uint32, paddedcounter, counting_allocator> h(16, 0.875f, counting_allocator(&live));
+				for (uint32 i = 0; i < 1000; ++i)
+				{
+					counters.pushBack(paddedcounter{ i });
+					EXPECT_TRUE(isAligned(counters.getData(), 64));
+					h.createItem(i, paddedcounter{ i });
+				}
+				for (uint32 i = 0; i < 1000; ++i)
+				{
+					EXPECT_EQ(counters[i].value, i);
+					EXPECT_TRUE(isAligned(h.findItem(i), 64));
+				}
+				counters.resize(10);
+				counters.shrink();
+				EXPECT_EQ(counters[9].value, 9u);
+			}
+			EXPECT_EQ(live, 0u);
+
+			coda::smallarray<paddedcounter, 2> heap;
+			for (uint32 i = 0; i < 3; ++i)
+				heap.pushBack(paddedcounter{ i });
+			EXPECT_TRUE(isAligned(heap.getData(), 64));
+
+			struct holder
+			{
+				byte misaligner;
+				coda::starray<paddedcounter, 2> counters;
+			} inlineCounters;
+			inlineCounters.counters.resize(2);
+			EXPECT_TRUE(isAligned(&inlineCounters.counters[1], 64));
+		}
+
+		TEST(instrumentation, containers)
+		{
+			coda::instrumentation::reset();
+			coda::hashtable<uint32, uint32> h(16);
+			for (uint32 i = 0; i < 1000; ++i)
+				h.createItem(i, i);
+			for (uint32 i = 0; i < 2000; ++i)
+				h.contains(i);
+			coda::dynarray<uint32> arr;
+			for (uint32 i = 0; i < 100; ++i)
+				arr.pushBack(i);
+			coda::string str("short");
+			str += " string, now long enough to live on the heap";
+
+			const coda::hashtablestats& tableStats = h.getStats();
+			const coda::arraystats& arrayStats = arr.getStats();
+			coda::instrumentationstats totals = coda::instrumentation::getTotals();
+#if CODA_INSTRUMENTATION
+			EXPECT_EQ(tableStats.inserts.get(), 1000u);
+			EXPECT_GT(tableStats.rehashes.get(), 0u);
+			EXPECT_GT(tableStats.migratedSlots.get(), 0u);
+			EXPECT_GE(tableStats.probes.get(), 2000u);
+			EXPECT_GE(tableStats.misses.get(), 1000u);
+			EXPECT_GE(tableStats.probedGroups.get(), tableStats.probes.get());
+			uint64 histogramTotal = 0;
+			for (const coda::statcounter& counter : tableStats.probeHistogram)
+				histogramTotal += counter.get();
+			EXPECT_EQ(histogramTotal, tableStats.probes.get());
+			EXPECT_GT(arrayStats.regrowths.get(), 0u);
+			EXPECT_EQ(arrayStats.relocations.get(), arrayStats.regrowths.get());
+			EXPECT_GT(arrayStats.bytesMoved.get(), 0u);
+			EXPECT_GE(totals.hashtable.inserts.get(), 1000u);
+			EXPECT_GE(totals.array.regrowths.get(), arrayStats.regrowths.get());
+			EXPECT_GE(totals.string.spills.get(), 1u);
+
+			// threads fold their stats into the totals when they exit
+			std::thread([]()
+				{
+					coda::hashtable<uint32, uint32> local(16);
+					local.createItem(1, 1);
+				}).join();
+			EXPECT_EQ(coda::instrumentation::getTotals().hashtable.inserts.get(), totals.hashtable.inserts.get() + 1);
+#else
+			EXPECT_EQ(tableStats.inserts.get(), 0u);
+			EXPECT_EQ(arrayStats.regrowths.get(), 0u);
+			EXPECT_EQ(totals.hashtable.probes.get(), 0u);
+#endif
+		}
+
+		TEST(instrumentation, trace)
+		{
+			coda::tracer::clear();
+			{
+				coda::tracezone zone("not captured");
+			}
+			EXPECT_EQ(coda::tracer::getEventCount(), 0u);
+
+			coda::tracer::begin();
+			{
+				coda::tracezone outer("outer");
+				std::thread([]() { coda::tracezone zone("worker"); }).join();
+			}
+			coda::tracer::end();
+			EXPECT_EQ(coda::tracer::getEventCount(), 2u);
+
+			std::string path = ::testing::TempDir() + "coda_trace.json";
+			ASSERT_TRUE(coda::tracer::writeJson(path.c_str()));
+			FILE* file = fopen(path.c_str(), "r");
+			ASSERT_NE(file, nullptr);
+			char json[1024] = {};
+			fread(json, 1, sizeof(json) - 1, file);
+			fclose(file);
+			remove(path.c_str());
+			EXPECT_NE(strstr(json, "\"traceEvents\""), nullptr);
+			EXPECT_NE(strstr(json, "\"name\": \"outer\""), nullptr);
+			EXPECT_NE(strstr(json, "\"name\": \"worker\""), nullptr);
+			EXPECT_NE(strstr(json, "\"ph\": \"X\""), nullptr);
+
+			coda::tracer::clear();
+			EXPECT_EQ(coda::tracer::getEventCount(), 0u);
+		}
+
+		// Checks every simd algorithm against a plain loop, for every size up to a few vectors
+		template <typename T>
+		void checkSimdAlgorithms(const dynarray<T>& values)
+		{
+			for (uint32 size = 0; size <= values.getSize(); ++size)
+			{
+				coda::span<const T> view = values.getSpan().getSubspan(0, size);
+				T sum = 0;
+				uint32 countFirst = 0;
+				for (T value : view)
+				{
+					sum = static_cast<T>(sum + value);
+					countFirst += value == values[0];
+				}
+				EXPECT_EQ(coda::simd::sum(view), sum);
+				EXPECT_EQ(coda::simd::count(view, values[0]), countFirst);
+				EXPECT_EQ(coda::simd::find(view, static_cast<T>(7)), coda::simd::invalidIndex);
+				if (size)
+				{
+					EXPECT_EQ(coda::simd::minimum(view), *std::min_element(view.begin(), view.end()));
+					EXPECT_EQ(coda::simd::maximum(view), *std::max_element(view.begin(), view.end()));
+					EXPECT_EQ(coda::simd::find(view, view[size - 1]), static_cast<uint32>(std::find(view.begin(), view.end(), view[size - 1]) - view.begin()));
+				}
+			}
+		}
+
+		TEST(simd, algorithms)
+		{
+			const coda::cpufeatures detected = coda::getCpuFeatures();
+			coda::cpufeatures levels[3];
+			levels[1].sse2 = true;
+			levels[2].sse2 = true;
+			levels[2].avx2 = true;
+
+			// integer values only so float sums are exact in any order
+			dynarray<float> floats;
+			dynarray<int32> ints;
+			dynarray<uint32> uints;
+			for (uint32 i = 0; i < 77; ++i)
+			{
+				int32 value = static_cast<int32>((i * 37) % 101) - 50;
+				if (value == 7)
+					value = 8;
+				floats.pushBack(static_cast<float>(value));
+				ints.pushBack(value);
+				// above 2^31, compared wrong as signed
+				uints.pushBack(static_cast<uint32>(value) ^ 0x80000000u);
+			}
+			for (const coda::cpufeatures& level : levels)
+			{
+				coda::setCpuFeatures(level);
+				checkSimdAlgorithms(floats);
+				checkSimdAlgorithms(ints);
+				checkSimdAlgorithms(uints);
+
+				dynarray<float> scaled;
+				scaled.resize(floats.getSize());
+				coda::simd::multiplyAdd(floats.getSpan(), scaled.getSpan(), 0.5f, 1.f);
+				for (uint32 i = 0; i < floats.getSize(); ++i)
+					EXPECT_EQ(scaled[i], floats[i] * 0.5f + 1.f);
+
+				coda::simd::fill(uints.getSpan().getSubspan(3, 50), 7u);
+				EXPECT_EQ(coda::simd::count(uints.getSpan(), 7u), 50u);
+				EXPECT_EQ(coda::simd::find(uints.getSpan(), 7u), 3u);
+				uints.fill(1u, 3, 50);
+			}
+			coda::setCpuFeatures(detected);
+		}
+
+		TEST(simd, fill)
+		{
+			struct pair
+			{
+				uint16 a;
+				uint16 b;
+			};
+
+			// repeated bytes go through memset, other values are stored one by one
+			dynarray<pair> pairs;
+			pairs.resize(100);
+			pairs.fill(pair{ 0xabab, 0xabab }, 0, 100);
+			pairs.fill(pair{ 1, 2 }, 10, 20);
+			for (uint32 i = 0; i < pairs.getSize(); ++i)
+			{
+				bool filled = i >= 10 && i < 30;
+				EXPECT_EQ(pairs[i].a, filled ? 1 : 0xabab);
+				EXPECT_EQ(pairs[i].b, filled ? 2 : 0xabab);
+			}
+
+			dynarray<tracked> objects;
+			objects.resize(4);
+			objects.fill(tracked(5), 1, 2);
+			EXPECT_EQ(objects[0].value, 0u);
+			EXPECT_EQ(objects[2].value, 5u);
+			EXPECT_EQ(objects[3].value, 0u);
+
+			std::vector<float> transformed(10);
+			dynarray<uint32> source;
+			for (uint32 i = 0; i < 10; ++i)
+				source.pushBack(i);
+			coda::simd::transform(source.getSpan(), coda::span<float>(transformed.data(), 10), [](uint32 v) { return v * 0.5f; });
+			EXPECT_EQ(transformed[9], 4.5f);
+		}
+
+		// Spawns 2^depth leaf tasks through nested groups
+		static void spawnTree(coda::taskgroup& group, uint32 depth, std::atomic<uint32>& leaves)
+		{
+			if (!depth)
+			{
+				leaves.fetch_add(1);
+				return;
+			}
+			group.run([&group, depth, &leaves]() { spawnTree(group, depth - 1, leaves); });
+			coda::taskgroup nested(group.getPool());
+			nested.run([&nested, depth, &leaves]() { spawnTree(nested, depth - 1, leaves); });
+		}
+
+		TEST(threadpool, taskgroup)
+		{
+			// no workers, the waiting thread runs every task
+			for (uint32 workers : { 0u, 3u })
+			{
+				coda::threadpool pool(workers);
+				EXPECT_EQ(pool.getConcurrency(), workers + 1);
+				std::atomic<uint32> leaves{ 0 };
+				{
+					coda::taskgroup group(pool);
+					spawnTree(group, 10, leaves);
+					group.wait();
+					EXPECT_EQ(leaves.load(), 1u << 10);
+				}
+
+				std::atomic<uint32> sum{ 0 };
+				coda::taskgroup group(pool);
+				for (uint32 i = 0; i < 1000; ++i)
+					group.run([i, &sum]() { sum.fetch_add(i); });
+				group.wait();
+				EXPECT_EQ(sum.load(), 999u * 1000 / 2);
+			}
+		}
+
+		TEST(parallel, algorithms)
+		{
+			coda::threadpool pool(3);
+			dynarray<uint32> values;
+			for (uint32 i = 0; i < 100000; ++i)
+				values.pushBack((i * 7919u) % 100003u);
+
+			// every index once
+			dynarray<uint32> visits;
+			visits.resize(values.getSize());
+			coda::parallelFor(visits.getSpan(), [](coda::span<uint32> piece)
+				{
+					for (uint32& visit : piece)
+						++visit;
+				}, 0, pool);
+			EXPECT_EQ(coda::simd::count(visits.getSpan(), 1u), visits.getSize());
+			coda::parallelFor(0, 0, [](uint32, uint32) { FAIL(); }, 0, pool);
+
+			uint64 expected = std::accumulate(values.begin(), values.end(), uint64(0));
+			auto sumPiece = [](coda::span<const uint32> piece) { return std::accumulate(piece.begin(), piece.end(), uint64(0)); };
+			auto add = [](uint64 a, uint64 b) { return a + b; };
+			EXPECT_EQ(coda::parallelReduce(coda::span<const uint32>(values.getSpan()), uint64(0), sumPiece, add, 0, pool), expected);
+			EXPECT_EQ(coda::parallelReduce(coda::span<const uint32>(values.getSpan()), uint64(0), sumPiece, add, 7, pool), expected);
+			EXPECT_EQ(coda::parallelReduce(coda::span<const uint32>(), uint64(5), sumPiece, add, 0, pool), 5u);
+
+			// small grains go through the parallel merges
+			for (uint32 grainSize : { 0u, 100u, 1u })
+			{
+				dynarray<uint32> sorted = values;
+				coda::parallelSort(sorted.getSpan(), std::less<uint32>(), grainSize, pool);
+				EXPECT_TRUE(std::is_sorted(sorted.begin(), sorted.end()));
+				EXPECT_EQ(std::accumulate(sorted.begin(), sorted.end(), uint64(0)), expected);
+			}
+
+			coda::starray<std::string, 64> names;
+			for (uint32 i = 0; i < 64; ++i)
+				names.pushBack(std::to_string((i * 37) % 64));
+			coda::parallelSort(names.getSpan(), std::greater<std::string>(), 4, pool);
+			EXPECT_TRUE(std::is_sorted(names.begin(), names.end(), std::greater<std::string>()));
+			EXPECT_EQ(names[63], "0");
+		}
 	}
 }
 